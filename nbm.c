@@ -9,41 +9,16 @@
  * SPDX-License-Identifier: Apache-2.0 
  */
 
+#include <stddef.h>
 #include "nbm.h"
+#include "nbm_private.h"
 
-#define GET_REG_FROM_FIELD(field) ((field) >> 12 & 0xF)
-#define GET_MSB_POS_FROM_FIELD(field) ((field) >> 5 & 0x7)
-#define GET_LSB_POS_FROM_FIELD(field) ((field) >> 2 & 0x7)
-#define GET_LENGTH_FROM_FIELD(field) (GET_MSB_POS_FROM_FIELD(field) - GET_LSB_POS_FROM_FIELD(field) + 1)
-#define GET_VALUE_MASK_FROM_FIELD(field) ((1 << GET_LENGTH_FROM_FIELD(field)) - 1)
-#define GET_MASK_FROM_FIELD(field) (GET_VALUE_MASK_FROM_FIELD(field) << GET_LSB_POS_FROM_FIELD(field))
-#define GET_DEVICE_FROM_FIELD(field) ((field) >> 2 & 0x7)
-#define GET_SOLO_IN_REG_FROM_FIELD(field) ((field) >> 1 & 0x1)
-#define GET_WRITEABLE_FIELD(field) ((field) >> 0 & 0x1)
-
-#define GET_ADDR(dev) \
-    (__builtin_parity((dev)->device_type & DEVICE_I2C_SERIES) ? \
-            (dev)->addr.i2c_addr : (dev)->addr.spi_ss_gpio)
-
-#define CHECK_DEVICE_FIELD(dev, field) \
-    if (!(GET_DEVICE_FROM_FIELD(field) & (dev)->device_type)) \
-         (dev)->error_code |= NBM_ERROR_INVALID_DEVICE
-
-#define ERROR_CHECK(dev) \
-    if ((dev)->error_code && (dev)->on_error_callback) \
-        (dev)->on_error_callback((dev)->error_code)
-
-#define SET_ERROR_AND_RUN_CALLBACK(dev, erno) \
-    do { \
-        (dev)->error_code |= (erno); \
-        ERROR_CHECK(dev); \
-    } while(0)
-
-
+#if NBM_CFG_VALIDATION
 /* local only fuctions, not exposed on api */
 static bool nbm_can_write_reg(enum nbm_registers reg);
 static bool nbm_is_valid_reg(enum nbm_registers reg);
 static bool nbm_is_valid_field(enum nbm_fields field);
+#endif
 
 void nbm_init(struct nbm_device *dev, enum nbm_types device_type, uint8_t addr,
             bool (*write_bytes_fcn)(uint8_t i2c_addr, uint8_t reg, const uint8_t *value, uint8_t len),
@@ -73,8 +48,18 @@ void nbm_init(struct nbm_device *dev, enum nbm_types device_type, uint8_t addr,
     else
         dev->error_code |= NBM_ERROR_NOT_INITALISED;
     
+#if NBM_CFG_PIN_HOOKS
+    /* pin hooks are optional, set them after init if you have them */
+    dev->read_ready_pin_fcn = NULL;
+    dev->write_start_pin_fcn = NULL;
+#endif
+
     /* on_error_callback is optional, pass NULL to not use */
+#if NBM_CFG_ERROR_CALLBACK
     dev->on_error_callback = on_error_callback;
+#else
+    (void) on_error_callback;
+#endif
 
     ERROR_CHECK(dev);
 
@@ -90,6 +75,7 @@ void nbm_write(struct nbm_device *dev, enum nbm_fields field, uint8_t value) {
 
     reg = GET_REG_FROM_FIELD(field);
     
+#if NBM_CFG_VALIDATION
     if (!nbm_can_write_reg(reg)){
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_NOT_WRITEABLE);
         return;
@@ -99,19 +85,25 @@ void nbm_write(struct nbm_device *dev, enum nbm_fields field, uint8_t value) {
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_INVALID_FIELD);
         return;
     }
+#endif
 
     /* sanitise the value and return error if value not valid, dont do it for the
      * the prof field however as mask will be wrong if upper 2 bits are set */
     masked_value = value & GET_VALUE_MASK_FROM_FIELD(field);
 
-    if (field == NBM_PROF) {
-        value = value >> 0x4 & 0x3;
-        /* no validity checks for value of prof, value has the two msb bits, these
-         * are in the profile_msb register and solo in reg so no pre read needed */
-    } else if (value != masked_value) {
+#if NBM_CFG_VALIDATION
+    if ((!NBM_CFG_PROF || field != NBM_PROF) && value != masked_value) {
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_INVALID_VALUE);
         return;
     }
+#endif
+
+#if NBM_CFG_PROF
+    /* no validity checks for value of prof, value has the two msb bits, these
+     * are in the profile_msb register and solo in reg so no pre read needed */
+    if (field == NBM_PROF)
+        value = value >> 0x4 & 0x3;
+#endif
     
     /* if the field is alone in the given register we avoid the need to read it
      * before any writes, and subsquent faffing around with bit shifting. */
@@ -124,10 +116,12 @@ void nbm_write(struct nbm_device *dev, enum nbm_fields field, uint8_t value) {
 
     /* Note there is no special handling of chenergy as its not writable */
     switch (field) {
+#if NBM_CFG_PROF
         case NBM_PROF:
             dev->error_code |= dev->write_bytes_fcn(GET_ADDR(dev), NBM_REG_PROFILE_MSB, &value, 1);
             dev->error_code |= dev->write_bytes_fcn(GET_ADDR(dev), reg, &masked_value, 1);
             break;
+#endif
         default:
             dev->error_code |= dev->write_bytes_fcn(GET_ADDR(dev), reg, &masked_value, 1);
     }
@@ -137,14 +131,19 @@ void nbm_write(struct nbm_device *dev, enum nbm_fields field, uint8_t value) {
 void nbm_read(struct nbm_device *dev, enum nbm_fields field, void *value) {
     /* value 1 byte long unless reading nbm_chengy in which case 4 */
 
+#if NBM_CFG_PROF
     uint8_t tmp;
+#endif
 
+#if NBM_CFG_VALIDATION
     if (!nbm_is_valid_field(field)) {
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_INVALID_FIELD);
         return;
     }
+#endif
 
     switch (field) {
+#if NBM_CFG_PROF
         case NBM_PROF:
             dev->error_code |= dev->read_bytes_fcn(GET_ADDR(dev), NBM_REG_PROFILE_MSB, &tmp, 1);
             dev->error_code |= dev->read_bytes_fcn(GET_ADDR(dev), GET_REG_FROM_FIELD(field), (uint8_t*) value, 1);
@@ -152,9 +151,12 @@ void nbm_read(struct nbm_device *dev, enum nbm_fields field, void *value) {
             (*(uint8_t*)value) = ((tmp & 0x3) << 0x4) |
                 ((*(uint8_t*)value) >> GET_LSB_POS_FROM_FIELD(field) & GET_MASK_FROM_FIELD(field));
             break;
+#endif
+#if NBM_CFG_CHENGY
         case NBM_CHENGY:
             dev->error_code |= dev->read_bytes_fcn(GET_ADDR(dev), NBM_REG_CHENERGY1, (uint8_t*) value, 4);
             break;
+#endif
         default:
             dev->error_code |= dev->read_bytes_fcn(GET_ADDR(dev), GET_REG_FROM_FIELD(field), (uint8_t*) value, 1);
             /* shift the lsb to 0 index and mask anything above top bit of field */
@@ -166,10 +168,12 @@ void nbm_read(struct nbm_device *dev, enum nbm_fields field, void *value) {
 
 void nbm_read_reg(struct nbm_device *dev, enum nbm_registers reg, uint8_t *value, uint8_t size) {
     
+#if NBM_CFG_VALIDATION
     if (!nbm_is_valid_reg(reg)) {
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_INVALID_REGISTER);
         return;
     }
+#endif
 
     dev->error_code |= dev->read_bytes_fcn(GET_ADDR(dev), reg, value, size);
     ERROR_CHECK(dev);
@@ -178,6 +182,7 @@ void nbm_read_reg(struct nbm_device *dev, enum nbm_registers reg, uint8_t *value
 
 void nbm_write_reg(struct nbm_device *dev, enum nbm_registers reg, const uint8_t *value, uint8_t size) {
         
+#if NBM_CFG_VALIDATION
     if (!nbm_is_valid_reg(reg)) {
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_INVALID_REGISTER);
         return;
@@ -187,11 +192,13 @@ void nbm_write_reg(struct nbm_device *dev, enum nbm_registers reg, const uint8_t
         SET_ERROR_AND_RUN_CALLBACK(dev, NBM_ERROR_NOT_WRITEABLE);
         return;
     }
+#endif
 
     dev->error_code |= dev->write_bytes_fcn(GET_ADDR(dev), reg, value, size);
     ERROR_CHECK(dev);
 }
 
+#if NBM_CFG_PIN_HOOKS
 void nbm_read_ready(struct nbm_device *dev, bool *value) {
     dev->error_code |= dev->read_ready_pin_fcn(0, value);
 }
@@ -199,7 +206,37 @@ void nbm_read_ready(struct nbm_device *dev, bool *value) {
 void nbm_write_start(struct nbm_device *dev, bool *value) {
     dev->error_code |= dev->write_start_pin_fcn(0, value);
 }
+#endif
+
+#if NBM_CFG_STATUS
+bool nbm_read_status(struct nbm_device *dev, struct nbm_status *status) {
+    /* status through to vcap are contiguous so grab them in a single transfer
+     * rather than one read per field */
+    uint8_t buf[NBM_REG_VCAP - NBM_REG_STATUS + 1] = {0};
+    bool failed;
+
+    /* error_code is sticky so look at this transfer's own result */
+    failed = dev->read_bytes_fcn(GET_ADDR(dev), NBM_REG_STATUS, buf, sizeof(buf));
+    dev->error_code |= failed;
+    if (failed) {
+        ERROR_CHECK(dev);
+        return 1;
+    }
 
+    status->lowbat = buf[NBM_REG_STATUS] >> GET_LSB_POS_FROM_FIELD(NBM_LOWBAT) & GET_VALUE_MASK_FROM_FIELD(NBM_LOWBAT);
+    status->ew = buf[NBM_REG_STATUS] >> GET_LSB_POS_FROM_FIELD(NBM_EW) & GET_VALUE_MASK_FROM_FIELD(NBM_EW);
+    status->alrm = buf[NBM_REG_STATUS] >> GET_LSB_POS_FROM_FIELD(NBM_ALRM) & GET_VALUE_MASK_FROM_FIELD(NBM_ALRM);
+    status->rdy = buf[NBM_REG_STATUS] >> GET_LSB_POS_FROM_FIELD(NBM_RDY) & GET_VALUE_MASK_FROM_FIELD(NBM_RDY);
+    /* chenergy1 is the lsb */
+    status->chengy = (uint32_t) buf[NBM_REG_CHENERGY1] | (uint32_t) buf[NBM_REG_CHENERGY2] << 8 |
+        (uint32_t) buf[NBM_REG_CHENERGY3] << 16 | (uint32_t) buf[NBM_REG_CHENERGY4] << 24;
+    status->vcap = buf[NBM_REG_VCAP] >> GET_LSB_POS_FROM_FIELD(NBM_VCAP) & GET_VALUE_MASK_FROM_FIELD(NBM_VCAP);
+
+    return 0;
+}
+#endif
+
+#if NBM_CFG_VALIDATION
 /* NOTE: in following do not use default when switching on enums. If we avoid
  * it's use, missing enum values in the switch block will be flagged. */
 
@@ -252,9 +289,12 @@ static bool nbm_is_valid_field(enum nbm_fields field) {
         case NBM_EW:
         case NBM_ALRM:
         case NBM_RDY:
+#if NBM_CFG_CHENGY
         case NBM_CHENGY:
+#endif
         case NBM_VCAP:
         case NBM_VCHEND:
+        /* without NBM_CFG_PROF only the 4 bits in the command register */
         case NBM_PROF:
         case NBM_RSTPF:
         case NBM_ACT:
@@ -273,10 +313,17 @@ static bool nbm_is_valid_field(enum nbm_fields field) {
         case NBM_VCAPMAX:
         case NBM_OPT_MARG:
             return 1;
+#if !NBM_CFG_CHENGY
+        /* compiled out, so as good as not there */
+        case NBM_CHENGY:
+            return 0;
+#endif
     }
     return 0;
 }
+#endif
 
+#if NBM_CFG_CONVERSIONS
 uint16_t nbm_vfix_to_mv(uint8_t vfix) {
     switch (vfix) {
         case NBM_VFIX_VAL_2V60:
@@ -387,3 +434,35 @@ uint16_t nbm_vcapmax_to_mv(uint8_t vcapmax) {
     return 0;
 }
 
+uint16_t nbm_ich_to_ma(uint8_t ich) {
+    switch (ich) {
+        case NBM_ICH_VAL_2mA:
+            return 2;
+        case NBM_ICH_VAL_4mA:
+            return 4;
+        case NBM_ICH_VAL_8mA:
+            return 8;
+        case NBM_ICH_VAL_16mA:
+            return 16;
+        case NBM_ICH_VAL_50mA:
+            return 50;
+    }
+    return 0;
+}
+
+uint16_t nbm_vmin_to_mv(uint8_t vmin) {
+    switch (vmin) {
+        case NBM_VMIN_VAL_2V4:
+            return 2400;
+        case NBM_VMIN_VAL_2V6:
+            return 2600;
+        case NBM_VMIN_VAL_2V8:
+            return 2800;
+        case NBM_VMIN_VAL_3V0:
+            return 3000;
+        case NBM_VMIN_VAL_3V2:
+            return 3200;
+    }
+    return 0;
+}
+#endif
@@ -18,6 +18,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "nbm_config.h"
 
 /* todo: implent use of these, currently makes no difference */
 enum nbm_types { 
@@ -257,11 +258,26 @@ struct nbm_device {
     /* user defined so will be SPI or I2C calls to MCU */
     bool (*write_bytes_fcn)(uint8_t i2c_addr, uint8_t reg, const uint8_t *value, uint8_t len);
     bool (*read_bytes_fcn)(uint8_t i2c_addr, uint8_t reg, uint8_t *value, uint8_t len);
+#if NBM_CFG_PIN_HOOKS
     /* user defined functions to read/write the two gpio pins */
     bool (*read_ready_pin_fcn)(void* pin, bool *state);
     bool (*write_start_pin_fcn)(void* pin, bool state);
+#endif
+#if NBM_CFG_ERROR_CALLBACK
     /* user defined if null will not be used */
     void (*on_error_callback)(uint8_t error_code);
+#endif
+};
+
+/* status, chenergy and vcap decoded from one read of registers 0..5, which
+ * is all the device tells us about what it is up to */
+struct nbm_status {
+    bool lowbat;
+    bool ew;
+    bool alrm;
+    bool rdy;
+    uint32_t chengy;
+    uint8_t vcap;
 };
 
 /* init fcn for the nbm, user passes the callbacks and devices settings */
@@ -275,13 +291,23 @@ void nbm_write(struct nbm_device *dev, enum nbm_fields field, uint8_t value);
 void nbm_read(struct nbm_device *dev, enum nbm_fields field, void *value);
 void nbm_read_reg(struct nbm_device *dev, enum nbm_registers, uint8_t *value, uint8_t size);
 void nbm_write_reg(struct nbm_device *dev, enum nbm_registers, const uint8_t *value, uint8_t size);
+#if NBM_CFG_PIN_HOOKS
 void nbm_read_ready(struct nbm_device *dev, bool *value);
 void nbm_write_start(struct nbm_device *dev, bool *value);
+#endif
+#if NBM_CFG_STATUS
+/* returns 1 if the read failed, status is then left as it was */
+bool nbm_read_status(struct nbm_device *dev, struct nbm_status *status);
+#endif
 
+#if NBM_CFG_CONVERSIONS
 /* some helpers for voltage comparisons you are likely to use */
 uint16_t nbm_vfix_to_mv(uint8_t vfix);
 uint16_t nbm_vcap_to_mv(uint8_t vcap);
 uint16_t nbm_vcapmax_to_mv(uint8_t vcapmax);
+uint16_t nbm_ich_to_ma(uint8_t ich);
+uint16_t nbm_vmin_to_mv(uint8_t vmin);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,368 @@
+/*
+ * header only c++ (11 or later) layer over nbm.h for the nbmx100x devices.
+ * by thomas169
+ *
+ * the c api takes any uint8_t for any field and a void * to read into, then
+ * sorts out at runtime whether that was sensible. here every field is a type
+ * whose register layout is worked out constexpr from its NBM_* enum value,
+ * every field has its own enum of codes (from the NBM_*_VAL_* defines) and the
+ * device type is a template parameter. so writing BALMODE on a 7100, AUTOMODE
+ * on a B part, a read only field or a code meant for another field does not
+ * compile. what is left at runtime is just the bus transfers themselves.
+ *
+ *     nbm_device raw;
+ *     nbm_init(&raw, NBM5100A, nbm_addr::NBM_I2C_ADDR_0x2E, write_fcn, read_fcn, NULL);
+ *     nbm::device<NBM5100A> nbm(raw);
+ *
+ *     nbm.write(nbm::vfix::v3v57);
+ *     nbm.write(nbm::prof::profile<37>());
+ *     uint16_t mv = nbm_vcap_to_mv(nbm.read<nbm::vcap>());
+ *     uint32_t chenergy = nbm.read<nbm::chengy>();
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_HPP_
+#define NBM_HPP_
+
+#include "nbm.h"
+
+namespace nbm {
+
+/* descriptor shared by all fields, everything but the devices it exists on
+ * is unpacked from the field's value in enum nbm_fields (see nbm.h) */
+template <nbm_fields Field, uint8_t Devices>
+struct field_desc {
+    static constexpr nbm_fields field = Field;
+    static constexpr nbm_registers reg = (nbm_registers) (Field >> 12 & 0xF);
+    static constexpr uint8_t msb = Field >> 5 & 0x7;
+    static constexpr uint8_t lsb = Field >> 2 & 0x7;
+    static constexpr uint8_t devices = Devices;
+    static constexpr bool writeable = (Field >> 0 & 0x1) != 0;
+    /* field is alone in its register so no need to read before writing */
+    static constexpr bool solo = (Field >> 1 & 0x1) != 0;
+    static constexpr uint8_t value_mask = (uint8_t) ((1u << (msb - lsb + 1)) - 1);
+    static constexpr uint8_t mask = (uint8_t) (value_mask << lsb);
+};
+
+/* each field has an enum called code of the values it can take, and a
+ * field_of() overload (declared only, for decltype) so that write() can work
+ * out the field from the code it is given */
+
+struct lowbat : field_desc<NBM_LOWBAT, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        vbat_good = NBM_LOWBAT_VAL_VBAT_GOOD,
+        vbat_low = NBM_LOWBAT_VAL_VBAT_LOW
+    };
+};
+
+struct ew : field_desc<NBM_EW, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        vcap_good = NBM_EW_VAL_VCAP_GOOD,
+        vcap_low = NBM_EW_VAL_VCAP_LOW
+    };
+};
+
+struct alrm : field_desc<NBM_ALRM, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        iload_good = NBM_ALRM_VAL_ILOAD_GOOD,
+        iload_to_high = NBM_ALRM_VAL_ILOAD_TO_HIGH
+    };
+};
+
+struct rdy : field_desc<NBM_RDY, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        cap_not_charged_or_reset = NBM_RDY_VAL_CAP_NOT_CHARGED_OR_RESET,
+        cap_charged = NBM_RDY_VAL_CAP_CHARGED
+    };
+};
+
+/* vcap and vchend share the same table */
+#define NBM_HPP_VCAP_CODES \
+    sub_1v1_a = NBM_VCAP_VAL_SUB_1V1_A, sub_1v1_b = NBM_VCAP_VAL_SUB_1V1_B, \
+    sub_1v1_c = NBM_VCAP_VAL_SUB_1V1_C, v1v10 = NBM_VCAP_VAL_1V10, v1v20 = NBM_VCAP_VAL_1V20, \
+    v1v30 = NBM_VCAP_VAL_1V30, v1v40 = NBM_VCAP_VAL_1V40, v1v51 = NBM_VCAP_VAL_1V51, \
+    v1v60 = NBM_VCAP_VAL_1V60, v1v71 = NBM_VCAP_VAL_1V71, v1v81 = NBM_VCAP_VAL_1V81, \
+    v1v99 = NBM_VCAP_VAL_1V99, v2v19 = NBM_VCAP_VAL_2V19, v2v40 = NBM_VCAP_VAL_2V40, \
+    v2v60 = NBM_VCAP_VAL_2V60, v2v79 = NBM_VCAP_VAL_2V79, v2v95 = NBM_VCAP_VAL_2V95, \
+    v3v01 = NBM_VCAP_VAL_3V01, v3v20 = NBM_VCAP_VAL_3V20, v3v27 = NBM_VCAP_VAL_3V27, \
+    v3v41 = NBM_VCAP_VAL_3V41, v3v57 = NBM_VCAP_VAL_3V57, v3v61 = NBM_VCAP_VAL_3V61, \
+    v3v84 = NBM_VCAP_VAL_3V84, v4v10 = NBM_VCAP_VAL_4V10, v4v33 = NBM_VCAP_VAL_4V33, \
+    v4v55 = NBM_VCAP_VAL_4V55, v4v76 = NBM_VCAP_VAL_4V76, v4v95 = NBM_VCAP_VAL_4V95, \
+    v5v16 = NBM_VCAP_VAL_5V16, v5v34 = NBM_VCAP_VAL_5V34, v5v54 = NBM_VCAP_VAL_5V54
+
+struct vcap : field_desc<NBM_VCAP, DEVICE_NBM_ALL> {
+    enum code : uint8_t { NBM_HPP_VCAP_CODES };
+};
+
+struct vchend : field_desc<NBM_VCHEND, DEVICE_NBM_ALL> {
+    enum code : uint8_t { NBM_HPP_VCAP_CODES };
+};
+
+#undef NBM_HPP_VCAP_CODES
+
+/* prof is bits 7..4 of command for its lower nibble and bits 1..0 of
+ * profile_msb for its top 2 bits, the descriptor covers the command part.
+ * profiles are numbered rather than named so use profile<n>() */
+struct prof : field_desc<NBM_PROF, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        no_optimiser = NBM_PROF_VAL_NO_OPTIMISER
+    };
+
+    template <uint8_t N>
+    static constexpr code profile() {
+        static_assert(N >= 1 && N <= 63, "profile must be 1..63");
+        return (code) N;
+    }
+};
+
+struct rstpf : field_desc<NBM_RSTPF, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        reset_profiler_inactive = NBM_RSTPF_VAL_RESET_PROFILER_INACTIVE,
+        reset_profiler_active = NBM_RSTPF_VAL_RESET_PROFILER_ACTIVE
+    };
+};
+
+struct act : field_desc<NBM_ACT, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        force_active_inactive = NBM_ACT_VAL_FORCE_ACTIVE_INACTIVE,
+        force_active_enable = NBM_ACT_VAL_FORCE_ACTIVE_ENABLE
+    };
+};
+
+struct ecm : field_desc<NBM_ECM, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        continuous_mode_inactive = NBM_ECM_VAL_CONTINUOUS_MODE_INACTIVE,
+        continuous_mode_enable = NBM_ECM_VAL_CONTINUOUS_MODE_ENABLE
+    };
+};
+
+struct eod : field_desc<NBM_EOD, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        on_demand_inactive = NBM_EOD_VAL_ON_DEMAND_INACTIVE,
+        on_demand_enable = NBM_EOD_VAL_ON_DEMAND_ENABLE
+    };
+};
+
+struct vfix : field_desc<NBM_VFIX, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        v2v60 = NBM_VFIX_VAL_2V60, v2v95 = NBM_VFIX_VAL_2V95, v3v27 = NBM_VFIX_VAL_3V27,
+        v3v57 = NBM_VFIX_VAL_3V57, v3v84 = NBM_VFIX_VAL_3V84, v4v10 = NBM_VFIX_VAL_4V10,
+        v4v33 = NBM_VFIX_VAL_4V33, v4v55 = NBM_VFIX_VAL_4V55, v4v76 = NBM_VFIX_VAL_4V76,
+        v4v96 = NBM_VFIX_VAL_4V96, v5v16 = NBM_VFIX_VAL_5V16, v5v34 = NBM_VFIX_VAL_5V34,
+        v5v54 = NBM_VFIX_VAL_5V54
+    };
+};
+
+struct vset : field_desc<NBM_VSET, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        v1v8 = NBM_VSET_VAL_1V8, v2v0 = NBM_VSET_VAL_2V0, v2v2 = NBM_VSET_VAL_2V2,
+        v2v4 = NBM_VSET_VAL_2V4, v2v5 = NBM_VSET_VAL_2V5, v2v6 = NBM_VSET_VAL_2V6,
+        v2v7 = NBM_VSET_VAL_2V7, v2v8 = NBM_VSET_VAL_2V8, v2v9 = NBM_VSET_VAL_2V9,
+        v3v0 = NBM_VSET_VAL_3V0, v3v1 = NBM_VSET_VAL_3V1, v3v2 = NBM_VSET_VAL_3V2,
+        v3v3 = NBM_VSET_VAL_3V3, v3v4 = NBM_VSET_VAL_3V4, v3v5 = NBM_VSET_VAL_3V5,
+        v3v6 = NBM_VSET_VAL_3V6
+    };
+};
+
+struct ich : field_desc<NBM_ICH, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        i2ma = NBM_ICH_VAL_2mA, i4ma = NBM_ICH_VAL_4mA, i8ma = NBM_ICH_VAL_8mA,
+        i16ma = NBM_ICH_VAL_16mA, i50ma = NBM_ICH_VAL_50mA
+    };
+};
+
+struct vdhhiz : field_desc<NBM_VDHHIZ, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        vdh_always_on = NBM_VDH_VAL_VDH_ALWAYS_ON,
+        vdh_hiz = NBM_VDH_VAL_VDH_HIZ
+    };
+};
+
+struct vmin : field_desc<NBM_VMIN, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        v2v4 = NBM_VMIN_VAL_2V4, v2v6 = NBM_VMIN_VAL_2V6, v2v8 = NBM_VMIN_VAL_2V8,
+        v3v0 = NBM_VMIN_VAL_3V0, v3v2 = NBM_VMIN_VAL_3V2
+    };
+};
+
+struct automode : field_desc<NBM_AUTOMODE, DEVICE_I2C_SERIES> {
+    enum code : uint8_t {
+        automode_inactive = NBM_AUTOMODE_VAL_AUTOMODE_INACTIVE,
+        automode_active = NBM_AUTOMODE_VAL_AUTOMODE_ACTIVE
+    };
+};
+
+/* nbm.h has no defines for eew, it is a plain enable bit */
+struct eew : field_desc<NBM_EEW, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        inactive = 0,
+        active = 1
+    };
+};
+
+struct vew : field_desc<NBM_VEW, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        v2v4 = NBM_VEW_VAL_2V4, v2v6 = NBM_VEW_VAL_2V6, v2v8 = NBM_VEW_VAL_2V8,
+        v3v0 = NBM_VEW_VAL_3V0, v3v2 = NBM_VEW_VAL_3V2, v3v4 = NBM_VEW_VAL_3V4,
+        v3v6 = NBM_VEW_VAL_3V6, v3v84 = NBM_VEW_VAL_3V84, v4v1 = NBM_VEW_VAL_4V1,
+        v4v3 = NBM_VEW_VAL_4V3
+    };
+};
+
+struct balmode : field_desc<NBM_BALMODE, DEVICE_5100_SERIES> {
+    enum code : uint8_t {
+        i1ma10 = NBM_BALMODE_VAL_1mA10, i2ma30 = NBM_BALMODE_VAL_2mA30,
+        i3ma15 = NBM_BALMODE_VAL_3mA15, i4ma90 = NBM_BALMODE_VAL_4mA90
+    };
+};
+
+struct enbal : field_desc<NBM_ENBAL, DEVICE_5100_SERIES> {
+    enum code : uint8_t {
+        inactive = NBM_ENBAL_VAL_INACTIVE,
+        active = NBM_ENBAL_VAL_ACTIVE
+    };
+};
+
+struct vcapmax : field_desc<NBM_VCAPMAX, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        v4v95 = NBM_VCAPMAX_VAL_4V95,
+        v5v54 = NBM_VCAPMAX_VAL_5V54
+    };
+};
+
+struct opt_marg : field_desc<NBM_OPT_MARG, DEVICE_NBM_ALL> {
+    enum code : uint8_t {
+        inactive = NBM_OPT_MARG_VAL_INACITVE, v2v19 = NBM_OPT_MARG_VAL_2V19,
+        v2v60 = NBM_OPT_MARG_VAL_2V60, v2v95 = NBM_OPT_MARG_VAL_2V95
+    };
+};
+
+/* chengy is the odd one out, 4 whole registers read as one uint32_t, and
+ * being read only it gets no field_of() */
+struct chengy : field_desc<NBM_CHENGY, DEVICE_NBM_ALL> {
+    typedef uint32_t code;
+};
+
+lowbat field_of(lowbat::code);
+ew field_of(ew::code);
+alrm field_of(alrm::code);
+rdy field_of(rdy::code);
+vcap field_of(vcap::code);
+vchend field_of(vchend::code);
+prof field_of(prof::code);
+rstpf field_of(rstpf::code);
+act field_of(act::code);
+ecm field_of(ecm::code);
+eod field_of(eod::code);
+vfix field_of(vfix::code);
+vset field_of(vset::code);
+ich field_of(ich::code);
+vdhhiz field_of(vdhhiz::code);
+vmin field_of(vmin::code);
+automode field_of(automode::code);
+eew field_of(eew::code);
+vew field_of(vew::code);
+balmode field_of(balmode::code);
+enbal field_of(enbal::code);
+vcapmax field_of(vcapmax::code);
+opt_marg field_of(opt_marg::code);
+
+/* wraps a nbm_device already set up by nbm_init(), errors still land in its
+ * error_code and on_error_callback as with the c api */
+template <nbm_types Type>
+class device {
+    static_assert(Type == NBM5100A || Type == NBM5100B || Type == NBM7100A || Type == NBM7100B,
+        "not a nbm device type");
+
+public:
+    explicit device(nbm_device &dev) : dev_(dev) {}
+
+    /* takes a code of one of the fields, eg nbm::vfix::v3v57 */
+    template <typename Code>
+    void write(Code code) {
+        typedef decltype(field_of(code)) Field;
+        static_assert(Field::devices & Type, "field not available on this device");
+        static_assert(Field::writeable, "field is read only");
+        write_field((uint8_t) code, tag<Field>());
+        error_check();
+    }
+
+    template <typename Field>
+    typename Field::code read() {
+        static_assert(Field::devices & Type, "field not available on this device");
+        typename Field::code result = read_field(tag<Field>());
+        error_check();
+        return result;
+    }
+
+    nbm_device &raw() { return dev_; }
+
+private:
+    nbm_device &dev_;
+
+    static constexpr bool is_i2c = (Type & DEVICE_I2C_SERIES) != 0;
+
+    uint8_t addr() const { return is_i2c ? (uint8_t) dev_.addr.i2c_addr : dev_.addr.spi_ss_gpio; }
+
+    void io_result(bool failed) {
+        dev_.error_code = (nbm_errors) (dev_.error_code | (failed ? NBM_ERROR_IO_ERROR : NBM_ERROR_NO_ERROR));
+    }
+
+    void error_check() {
+#if NBM_CFG_ERROR_CALLBACK
+        if (dev_.error_code && dev_.on_error_callback)
+            dev_.on_error_callback(dev_.error_code);
+#endif
+    }
+
+    uint8_t read_byte(nbm_registers reg) {
+        uint8_t tmp = 0;
+        io_result(dev_.read_bytes_fcn(addr(), reg, &tmp, 1));
+        return tmp;
+    }
+
+    void write_byte(nbm_registers reg, uint8_t byte) {
+        io_result(dev_.write_bytes_fcn(addr(), reg, &byte, 1));
+    }
+
+    /* overloads are picked by tag so prof and chengy can do their own thing */
+    template <typename Field> struct tag {};
+
+    /* generic case, read-modify-write unless the field has the reg to itself */
+    template <typename Field>
+    void write_field(uint8_t code, tag<Field>) {
+        uint8_t byte = (uint8_t) (code << Field::lsb);
+        if (!Field::solo)
+            byte |= read_byte(Field::reg) & (uint8_t) ~Field::mask;
+        write_byte(Field::reg, byte);
+    }
+
+    /* top 2 bits of prof go in profile_msb (which it has to itself) */
+    void write_field(uint8_t code, tag<prof>) {
+        write_byte(NBM_REG_PROFILE_MSB, (uint8_t) (code >> 4 & 0x3));
+        write_field<prof>(code & prof::value_mask, tag<prof>());
+    }
+
+    template <typename Field>
+    typename Field::code read_field(tag<Field>) {
+        return (typename Field::code) (read_byte(Field::reg) >> Field::lsb & Field::value_mask);
+    }
+
+    prof::code read_field(tag<prof>) {
+        uint8_t msb = read_byte(NBM_REG_PROFILE_MSB);
+        return (prof::code) ((msb & 0x3) << 4 | read_field<prof>(tag<prof>()));
+    }
+
+    /* assembled explicitly with chenergy1 as the lsb so host endianness
+     * does not matter */
+    uint32_t read_field(tag<chengy>) {
+        uint8_t b[4] = {0, 0, 0, 0};
+        io_result(dev_.read_bytes_fcn(addr(), NBM_REG_CHENERGY1, b, 4));
+        return (uint32_t) b[0] | (uint32_t) b[1] << 8 | (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24;
+    }
+};
+
+} /* namespace nbm */
+
+#endif /* include guard */
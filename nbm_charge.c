@@ -0,0 +1,154 @@
+/*
+ * charge time estimator for the nbmx100x devices.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+#include "nbm.h"
+#include "nbm_charge.h"
+
+#if !NBM_CFG_CONVERSIONS
+#error "nbm_charge.c needs NBM_CFG_CONVERSIONS"
+#endif
+
+/* ewma weight as a shift, ie each new slope counts for 1/4 */
+#define SLOPE_FILTER_SHIFT 2
+/* no point counting past this, only used to tell the first slope apart */
+#define N_SLOPES_MAX 0xFF
+
+static uint32_t abs_diff(uint32_t a, uint32_t b);
+static uint32_t time_to_rdy(const struct nbm_charge_est *est, uint32_t slope);
+
+void nbm_charge_est_init(struct nbm_charge_est *est, uint8_t ich, uint8_t vchend, uint32_t cap_uf) {
+
+    est->vchend_mv = nbm_vcap_to_mv(vchend);
+    est->anchor_ms = 0;
+    est->anchor_gap_ms = 0;
+    est->last_ms = 0;
+    est->anchor_mv = 0;
+    est->anchor_span_mv = 0;
+    est->last_vcap = 0;
+    est->n_slopes = 0;
+    est->has_sample = 0;
+
+    /* dv/dt = i/c, with i in uA and c in uF that is V/s so scale up to uV/ms.
+     * give the prior a generous deviation as cap tolerance is rarely tight */
+    if (cap_uf) {
+        est->slope = (uint32_t) nbm_ich_to_ma(ich) * 1000000UL / cap_uf;
+        est->slope_dev = est->slope >> 1;
+    } else {
+        est->slope = 0;
+        est->slope_dev = 0;
+    }
+}
+
+void nbm_charge_est_update(struct nbm_charge_est *est, uint8_t vcap, uint32_t now_ms) {
+
+    uint16_t mv;
+    uint32_t dt;
+    uint32_t observed;
+    uint32_t err;
+
+    mv = nbm_vcap_to_mv(vcap);
+
+    if (!est->has_sample || vcap < est->last_vcap) {
+        /* first sample or vcap dropped under load, either way start over. the
+         * real voltage is anywhere up to the next code */
+        est->anchor_ms = now_ms;
+        est->anchor_gap_ms = 0;
+        est->anchor_mv = mv;
+        est->anchor_span_mv = vcap < NBM_VCAP_VAL_5V54 ? nbm_vcap_to_mv(vcap + 1) - mv : 0;
+    } else if (vcap > est->last_vcap) {
+        /* only a code change tells us anything, the time between the two
+         * anchors is a (quantised) measure of the slope. not from an anchor
+         * set on a restart though, where vcap could be anywhere in its code */
+        dt = now_ms - est->anchor_ms;
+        if (dt && mv > est->anchor_mv && !est->anchor_span_mv) {
+            observed = (uint32_t) (mv - est->anchor_mv) * 1000UL / dt;
+            err = abs_diff(observed, est->slope);
+
+            if (!est->n_slopes && !est->slope) {
+                /* nothing to go on before this so take it as is */
+                est->slope = observed;
+                est->slope_dev = observed >> 2;
+            } else {
+                if (observed > est->slope)
+                    est->slope += (observed - est->slope) >> SLOPE_FILTER_SHIFT;
+                else
+                    est->slope -= (est->slope - observed) >> SLOPE_FILTER_SHIFT;
+
+                if (err > est->slope_dev)
+                    est->slope_dev += (err - est->slope_dev) >> SLOPE_FILTER_SHIFT;
+                else
+                    est->slope_dev -= (est->slope_dev - err) >> SLOPE_FILTER_SHIFT;
+            }
+
+            if (est->n_slopes < N_SLOPES_MAX)
+                est->n_slopes++;
+        }
+        /* vcap crossed mv somewhere since the last sample */
+        est->anchor_ms = now_ms;
+        est->anchor_gap_ms = now_ms - est->last_ms;
+        est->anchor_mv = mv;
+        est->anchor_span_mv = 0;
+    }
+
+    est->last_vcap = vcap;
+    est->last_ms = now_ms;
+    est->has_sample = 1;
+}
+
+uint32_t nbm_charge_est_predict(const struct nbm_charge_est *est, uint32_t *min_ms, uint32_t *max_ms) {
+
+    uint32_t slope_hi;
+    uint32_t slope_lo;
+    uint32_t nominal;
+    uint32_t early;
+    uint32_t slack;
+
+    slope_hi = est->slope + (est->slope_dev << 1);
+    slope_lo = est->slope > (est->slope_dev << 1) ? est->slope - (est->slope_dev << 1) : 0;
+
+    nominal = time_to_rdy(est, est->slope);
+
+    /* the anchor is where vcap was first seen at its code, the real crossing
+     * (or voltage) can be ahead of that by a sample interval (or a code) so
+     * take that off the lower bound */
+    if (min_ms) {
+        early = time_to_rdy(est, slope_hi);
+        if (early != NBM_CHARGE_EST_UNKNOWN && early) {
+            slack = est->anchor_gap_ms + (uint32_t) est->anchor_span_mv * 1000UL / slope_hi;
+            early = early > slack ? early - slack : 0;
+        }
+        *min_ms = early;
+    }
+    if (max_ms)
+        *max_ms = time_to_rdy(est, slope_lo);
+
+    return nominal;
+}
+
+static uint32_t abs_diff(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+static uint32_t time_to_rdy(const struct nbm_charge_est *est, uint32_t slope) {
+
+    uint32_t total;
+    uint32_t elapsed;
+
+    if (est->has_sample && est->anchor_mv >= est->vchend_mv)
+        return 0;
+
+    if (!est->has_sample || !slope)
+        return NBM_CHARGE_EST_UNKNOWN;
+
+    /* time from the anchor to vchend less what has already passed since, the
+     * real voltage has moved on from the anchor even if the code has not */
+    total = (uint32_t) (est->vchend_mv - est->anchor_mv) * 1000UL / slope;
+    elapsed = est->last_ms - est->anchor_ms;
+
+    return total > elapsed ? total - elapsed : 0;
+}
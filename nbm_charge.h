@@ -0,0 +1,57 @@
+/*
+ * charge time estimator for the nbmx100x devices. feed it vcap readings as
+ * you take them and it tells you how long until the storage capacitor hits
+ * vchend (ie RDY goes high), so you can sleep once instead of polling.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_CHARGE_H_
+#define NBM_CHARGE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* returned by nbm_charge_est_predict() when there is not enough info yet */
+#define NBM_CHARGE_EST_UNKNOWN UINT32_MAX
+
+/* all slopes are in uV/ms (same as mV/s), times in ms. the user owns the
+ * clock, any free running ms counter will do as wrap around is handled. */
+struct nbm_charge_est {
+    uint32_t slope;        /* filtered charge slope */
+    uint32_t slope_dev;    /* filtered absolute deviation of the slope */
+    uint32_t anchor_ms;    /* time vcap was first seen at its current code */
+    uint32_t anchor_gap_ms; /* the code changed up to this long before the anchor */
+    uint32_t last_ms;      /* time of the most recent sample */
+    uint16_t anchor_mv;    /* vcap in mV at the anchor */
+    uint16_t anchor_span_mv; /* vcap may be up to this far above anchor_mv */
+    uint16_t vchend_mv;    /* charging stops (and RDY is set) here */
+    uint8_t last_vcap;     /* most recent vcap code */
+    uint8_t n_slopes;      /* number of slopes observed, saturates */
+    bool has_sample;
+};
+
+/* ich and vchend are the NBM_ICH_VAL_* and NBM_VCAP_VAL_* codes configured on
+ * the device. cap_uf is the storage capacitance, used to seed the slope before
+ * anything has been observed, pass 0 if you dont know it. */
+void nbm_charge_est_init(struct nbm_charge_est *est, uint8_t ich, uint8_t vchend, uint32_t cap_uf);
+
+/* feed a raw vcap code (as read from NBM_VCAP) taken at now_ms. a drop in vcap
+ * (ie a load pulse) restarts tracking but keeps what was learnt of the slope */
+void nbm_charge_est_update(struct nbm_charge_est *est, uint8_t vcap, uint32_t now_ms);
+
+/* predicted ms from the last sample until RDY, 0 if already charged or
+ * NBM_CHARGE_EST_UNKNOWN if no slope is known yet. min_ms and max_ms get the
+ * bounds (slope +/- 2 deviations), either may be NULL. */
+uint32_t nbm_charge_est_predict(const struct nbm_charge_est *est, uint32_t *min_ms, uint32_t *max_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* include guard */
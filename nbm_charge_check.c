@@ -0,0 +1,119 @@
+/*
+ * check of the charge time estimator against a simulated device: vcap is
+ * ramped at a constant current, quantised through the vcap code table and
+ * sampled like firmware would. every prediction has to bracket the true time
+ * until vcap reaches vchend.
+ * by thomas169
+ *
+ * build and run:
+ *     cc -o nbm_charge_check nbm_charge_check.c nbm_charge.c nbm.c && ./nbm_charge_check
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+#include "nbm_charge.h"
+
+/* pulses per scenario, the estimator keeps its slope across them */
+#define N_CYCLES 4
+
+struct scenario {
+    uint8_t ich;
+    uint8_t vchend;
+    uint32_t cap_uf;        /* what the estimator is told */
+    uint32_t real_cap_uf;   /* what the simulated device actually has */
+    uint16_t start_mv;      /* vcap just after each pulse */
+    uint32_t sample_ms;     /* how often vcap is read */
+};
+
+static const struct scenario scenarios[] = {
+    {NBM_ICH_VAL_16mA, NBM_VCAP_VAL_4V95, 1000, 1000, 3000, 5},
+    {NBM_ICH_VAL_16mA, NBM_VCAP_VAL_4V95, 1200, 1000, 3000, 5},
+    {NBM_ICH_VAL_8mA, NBM_VCAP_VAL_4V55, 800, 1000, 2600, 10},
+    {NBM_ICH_VAL_2mA, NBM_VCAP_VAL_3V84, 0, 2200, 2400, 100},
+    {NBM_ICH_VAL_50mA, NBM_VCAP_VAL_5V16, 4700, 3300, 3200, 2},
+    /* starting between codes, so the first code seen is below the real vcap */
+    {NBM_ICH_VAL_16mA, NBM_VCAP_VAL_4V95, 1000, 1000, 2420, 5},
+    {NBM_ICH_VAL_16mA, NBM_VCAP_VAL_4V95, 1000, 1000, 3550, 7},
+    {NBM_ICH_VAL_8mA, NBM_VCAP_VAL_4V55, 1000, 1000, 2990, 13},
+    {NBM_ICH_VAL_4mA, NBM_VCAP_VAL_4V10, 470, 680, 1705, 9},
+    {NBM_ICH_VAL_2mA, NBM_VCAP_VAL_3V84, 0, 2200, 2555, 100}
+};
+
+/* code the device would report for v, ie the highest at or below it */
+static uint8_t vcap_code(uint32_t uv) {
+    uint8_t code;
+    uint8_t best = NBM_VCAP_VAL_SUB_1V1_A;
+
+    for (code = NBM_VCAP_VAL_1V10; code <= NBM_VCAP_VAL_5V54; code++)
+        if ((uint32_t) nbm_vcap_to_mv(code) * 1000 <= uv)
+            best = code;
+    return best;
+}
+
+static bool run(const struct scenario *sc) {
+
+    struct nbm_charge_est est;
+    uint32_t slope = (uint32_t) nbm_ich_to_ma(sc->ich) * 1000000UL / sc->real_cap_uf;
+    uint32_t vchend_uv = (uint32_t) nbm_vcap_to_mv(sc->vchend) * 1000;
+    uint32_t now = 1000;
+    uint32_t t;
+    uint32_t uv;
+    uint32_t truth;
+    uint32_t pred;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint8_t cycle;
+    uint32_t n_checked = 0;
+    bool ok = 1;
+
+    nbm_charge_est_init(&est, sc->ich, sc->vchend, sc->cap_uf);
+
+    for (cycle = 0; cycle < N_CYCLES; cycle++) {
+        for (t = 0; ; t += sc->sample_ms) {
+            uv = sc->start_mv * 1000UL + slope * t;
+            if (uv > vchend_uv)
+                uv = vchend_uv;
+            nbm_charge_est_update(&est, vcap_code(uv), now + t);
+
+            truth = (vchend_uv - uv) / slope;
+            pred = nbm_charge_est_predict(&est, &min_ms, &max_ms);
+
+            /* nothing to go on until the first code step if no cap was given */
+            if (pred != NBM_CHARGE_EST_UNKNOWN) {
+                n_checked++;
+                if (truth < min_ms || truth > max_ms) {
+                    printf("FAIL ich %u cap %lu/%lu cycle %u t %lu: truth %lu not in [%lu, %lu] (pred %lu)\n",
+                        nbm_ich_to_ma(sc->ich), (unsigned long) sc->cap_uf, (unsigned long) sc->real_cap_uf,
+                        cycle, (unsigned long) t, (unsigned long) truth, (unsigned long) min_ms,
+                        (unsigned long) max_ms, (unsigned long) pred);
+                    ok = 0;
+                }
+            }
+            if (uv >= vchend_uv)
+                break;
+        }
+        /* idle a while then a pulse pulls vcap back down */
+        now += t + 1000;
+        nbm_charge_est_update(&est, vcap_code(sc->start_mv * 1000UL), now);
+    }
+
+    printf("%s ich %umA cap %lu/%luuF: %lu predictions checked\n", ok ? "ok  " : "FAIL",
+        nbm_ich_to_ma(sc->ich), (unsigned long) sc->cap_uf, (unsigned long) sc->real_cap_uf,
+        (unsigned long) n_checked);
+    return ok;
+}
+
+int main(void) {
+
+    size_t i;
+    bool ok = 1;
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        ok &= run(&scenarios[i]);
+
+    return ok ? 0 : 1;
+}
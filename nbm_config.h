@@ -0,0 +1,56 @@
+/*
+ * compile time feature selection for the nbm library. everything is on by
+ * default, turn off what you dont need to shrink the build for small mcus
+ * either by editing here or from the command line, eg -DNBM_CFG_VALIDATION=0.
+ * run size_report.sh with your toolchain to see what each option costs.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_CONFIG_H_
+#define NBM_CONFIG_H_
+
+/* runtime checks of field, register and value arguments in nbm_write(),
+ * nbm_read(), nbm_read_reg() and nbm_write_reg(). with this off bad arguments
+ * are sent to the device as is */
+#ifndef NBM_CFG_VALIDATION
+#define NBM_CFG_VALIDATION 1
+#endif
+
+/* nbm_vfix_to_mv(), nbm_vcap_to_mv(), nbm_vcapmax_to_mv(), nbm_ich_to_ma() and
+ * nbm_vmin_to_mv() */
+#ifndef NBM_CFG_CONVERSIONS
+#define NBM_CFG_CONVERSIONS 1
+#endif
+
+/* handling of the top 2 bits of NBM_PROF in the profile_msb register. with
+ * this off NBM_PROF is treated as a plain 4 bit field in the command register,
+ * so only profiles 0..15 can be written (larger values are rejected as
+ * invalid) and profile_msb is left alone */
+#ifndef NBM_CFG_PROF
+#define NBM_CFG_PROF 1
+#endif
+
+/* reading NBM_CHENGY as 4 bytes with nbm_read() */
+#ifndef NBM_CFG_CHENGY
+#define NBM_CFG_CHENGY 1
+#endif
+
+/* on_error_callback in nbm_device, with this off nbm_init() ignores it and
+ * errors are only seen in error_code */
+#ifndef NBM_CFG_ERROR_CALLBACK
+#define NBM_CFG_ERROR_CALLBACK 1
+#endif
+
+/* ready/start pin functions in nbm_device, nbm_read_ready() and nbm_write_start() */
+#ifndef NBM_CFG_PIN_HOOKS
+#define NBM_CFG_PIN_HOOKS 1
+#endif
+
+/* nbm_read_status() */
+#ifndef NBM_CFG_STATUS
+#define NBM_CFG_STATUS 1
+#endif
+
+#endif /* include guard */
@@ -0,0 +1,152 @@
+/*
+ * remaining battery life predictor for the nbmx100x devices.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "nbm_life.h"
+
+#if !NBM_CFG_STATUS
+#error "nbm_life.c needs NBM_CFG_STATUS"
+#endif
+
+/* rates are counts per s in q16 */
+#define RATE_SHIFT 16
+/* ewma weight as a shift, the battery drains slowly so smooth harder than
+ * the charge estimator */
+#define RATE_FILTER_SHIFT 3
+/* 1 mWh is 3.6e6 uJ */
+#define UJ_PER_MWH 3600000ULL
+/* a drop in CHENGY is taken as the counter wrapping if what that implies is
+ * within this many times what the rate (plus 2 deviations) predicts */
+#define WRAP_SLACK 4
+
+static bool is_plausible(const struct nbm_life *life, uint32_t delta, uint32_t dt);
+static uint32_t time_for(uint64_t remaining, uint64_t rate);
+static uint32_t time_after(uint32_t last_s, uint32_t dt_s);
+
+void nbm_life_init(struct nbm_life *life, uint32_t capacity_mwh, uint32_t uj_per_count,
+        uint8_t lowbat_reserve_pct) {
+
+    life->capacity = uj_per_count ? capacity_mwh * UJ_PER_MWH / uj_per_count : 0;
+    life->consumed = 0;
+    life->rate = 0;
+    life->rate_dev = 0;
+    life->last_chengy = 0;
+    life->last_s = 0;
+    life->lowbat_reserve_pct = lowbat_reserve_pct < 100 ? lowbat_reserve_pct : 99;
+    life->has_sample = 0;
+    life->has_rate = 0;
+    life->calibrated = 0;
+    life->last_lowbat = 0;
+}
+
+void nbm_life_update(struct nbm_life *life, const struct nbm_status *status, uint32_t now_s) {
+
+    uint32_t delta;
+    uint32_t dt;
+    uint64_t observed;
+    uint64_t err;
+
+    if (life->has_sample) {
+        /* modular so a 32 bit wrap is counted in full, a drop that does not
+         * fit the rate is the device having been reset instead */
+        delta = status->chengy - life->last_chengy;
+        dt = now_s - life->last_s;
+        if (status->chengy < life->last_chengy && !is_plausible(life, delta, dt))
+            delta = status->chengy;
+        life->consumed += delta;
+
+        if (dt) {
+            observed = ((uint64_t) delta << RATE_SHIFT) / dt;
+            if (!life->has_rate) {
+                life->rate = observed;
+                life->rate_dev = observed >> 2;
+                life->has_rate = 1;
+            } else {
+                err = observed > life->rate ? observed - life->rate : life->rate - observed;
+                if (observed > life->rate)
+                    life->rate += (observed - life->rate) >> RATE_FILTER_SHIFT;
+                else
+                    life->rate -= (life->rate - observed) >> RATE_FILTER_SHIFT;
+
+                if (err > life->rate_dev)
+                    life->rate_dev += (err - life->rate_dev) >> RATE_FILTER_SHIFT;
+                else
+                    life->rate_dev -= (life->rate_dev - err) >> RATE_FILTER_SHIFT;
+            }
+        }
+
+        /* the first LOWBAT tells us where the battery really is, so what has
+         * been used so far is all but the reserve */
+        if (status->lowbat && !life->last_lowbat && !life->calibrated && life->consumed) {
+            life->capacity = life->consumed * 100 / (100 - life->lowbat_reserve_pct);
+            life->calibrated = 1;
+        }
+    }
+
+    life->last_chengy = status->chengy;
+    life->last_s = now_s;
+    life->last_lowbat = status->lowbat;
+    life->has_sample = 1;
+}
+
+void nbm_life_counter_reset(struct nbm_life *life) {
+    /* the next reading is then all new consumption */
+    life->last_chengy = 0;
+}
+
+void nbm_life_predict(const struct nbm_life *life, struct nbm_life_estimate *estimate) {
+
+    uint64_t remaining;
+    uint64_t spread;
+
+    remaining = life->capacity > life->consumed ? life->capacity - life->consumed : 0;
+    spread = life->rate_dev << 1;
+
+    if (!life->has_rate) {
+        estimate->remaining_s = remaining ? NBM_LIFE_UNKNOWN : 0;
+        estimate->remaining_min_s = estimate->remaining_s;
+        estimate->remaining_max_s = estimate->remaining_s;
+    } else {
+        estimate->remaining_s = time_for(remaining, life->rate);
+        estimate->remaining_min_s = time_for(remaining, life->rate + spread);
+        estimate->remaining_max_s = time_for(remaining, life->rate > spread ? life->rate - spread : 0);
+    }
+
+    estimate->eol_s = time_after(life->last_s, estimate->remaining_s);
+    estimate->eol_min_s = time_after(life->last_s, estimate->remaining_min_s);
+    estimate->eol_max_s = time_after(life->last_s, estimate->remaining_max_s);
+}
+
+/* could delta have been used in dt at the rate seen so far */
+static bool is_plausible(const struct nbm_life *life, uint32_t delta, uint32_t dt) {
+
+    uint64_t expected;
+
+    if (!life->has_rate)
+        return 0;
+    expected = (life->rate + (life->rate_dev << 1)) * dt >> RATE_SHIFT;
+    return delta <= expected * WRAP_SLACK + 1;
+}
+
+static uint32_t time_for(uint64_t remaining, uint64_t rate) {
+
+    uint64_t t;
+
+    if (!remaining)
+        return 0;
+    if (!rate)
+        return NBM_LIFE_UNKNOWN;
+
+    t = (remaining << RATE_SHIFT) / rate;
+    return t < NBM_LIFE_UNKNOWN ? (uint32_t) t : NBM_LIFE_UNKNOWN - 1;
+}
+
+/* saturates rather than wrapping past the end of the users clock */
+static uint32_t time_after(uint32_t last_s, uint32_t dt_s) {
+    if (dt_s > NBM_LIFE_UNKNOWN - last_s)
+        return NBM_LIFE_UNKNOWN;
+    return last_s + dt_s;
+}
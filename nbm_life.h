@@ -0,0 +1,74 @@
+/*
+ * remaining battery life predictor for the nbmx100x devices. feed it each
+ * nbm_status you read and it tracks energy used (from CHENGY) against the
+ * battery capacity, the trend of the consumption rate and recalibrates the
+ * capacity when LOWBAT first asserts.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_LIFE_H_
+#define NBM_LIFE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+
+/* in the estimate when there is not enough info yet */
+#define NBM_LIFE_UNKNOWN UINT32_MAX
+
+/* energy is kept in CHENGY counts and rates in counts per s scaled by 2^16,
+ * times are in s on any clock of the users (eg an rtc) */
+struct nbm_life {
+    uint64_t capacity;     /* battery capacity in counts */
+    uint64_t consumed;     /* counts used since init */
+    uint64_t rate;         /* filtered consumption rate */
+    uint64_t rate_dev;     /* filtered absolute deviation of the rate */
+    uint32_t last_chengy;
+    uint32_t last_s;
+    uint8_t lowbat_reserve_pct;
+    bool has_sample;
+    bool has_rate;
+    bool calibrated;       /* capacity has been corrected from LOWBAT */
+    bool last_lowbat;
+};
+
+/* remaining is from the last sample, eol is the time on the users clock (or
+ * NBM_LIFE_UNKNOWN if past the end of it). min and max are with the rate 2
+ * deviations either side of its trend */
+struct nbm_life_estimate {
+    uint32_t remaining_s;
+    uint32_t remaining_min_s;
+    uint32_t remaining_max_s;
+    uint32_t eol_s;
+    uint32_t eol_min_s;
+    uint32_t eol_max_s;
+};
+
+/* capacity_mwh is the usable battery capacity and uj_per_count the energy of
+ * one CHENGY count (from the datasheet for your setup). lowbat_reserve_pct is
+ * how much of the capacity you reckon is left when LOWBAT first asserts */
+void nbm_life_init(struct nbm_life *life, uint32_t capacity_mwh, uint32_t uj_per_count,
+    uint8_t lowbat_reserve_pct);
+
+/* O(1). a drop in CHENGY is taken as the 32 bit counter wrapping if that fits
+ * the consumption rate seen so far, otherwise as the device having been reset
+ * so the new value is all new consumption */
+void nbm_life_update(struct nbm_life *life, const struct nbm_status *status, uint32_t now_s);
+
+/* call when you know the device was reset (eg after power up or nbm_init())
+ * so the next CHENGY is taken as all new consumption, whatever it is */
+void nbm_life_counter_reset(struct nbm_life *life);
+
+void nbm_life_predict(const struct nbm_life *life, struct nbm_life_estimate *estimate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* include guard */
@@ -0,0 +1,47 @@
+/*
+ * internal helpers shared by the nbm*.c files, not part of the api. unpacks
+ * the register layout packed into enum nbm_fields and does the error
+ * callback.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_PRIVATE_H_
+#define NBM_PRIVATE_H_
+
+#include "nbm.h"
+
+#define GET_REG_FROM_FIELD(field) ((field) >> 12 & 0xF)
+#define GET_MSB_POS_FROM_FIELD(field) ((field) >> 5 & 0x7)
+#define GET_LSB_POS_FROM_FIELD(field) ((field) >> 2 & 0x7)
+#define GET_LENGTH_FROM_FIELD(field) (GET_MSB_POS_FROM_FIELD(field) - GET_LSB_POS_FROM_FIELD(field) + 1)
+#define GET_VALUE_MASK_FROM_FIELD(field) ((1 << GET_LENGTH_FROM_FIELD(field)) - 1)
+#define GET_MASK_FROM_FIELD(field) (GET_VALUE_MASK_FROM_FIELD(field) << GET_LSB_POS_FROM_FIELD(field))
+#define GET_DEVICE_FROM_FIELD(field) ((field) >> 2 & 0x7)
+#define GET_SOLO_IN_REG_FROM_FIELD(field) ((field) >> 1 & 0x1)
+#define GET_WRITEABLE_FIELD(field) ((field) >> 0 & 0x1)
+
+#define GET_ADDR(dev) \
+    (__builtin_parity((dev)->device_type & DEVICE_I2C_SERIES) ? \
+            (dev)->addr.i2c_addr : (dev)->addr.spi_ss_gpio)
+
+#define CHECK_DEVICE_FIELD(dev, field) \
+    if (!(GET_DEVICE_FROM_FIELD(field) & (dev)->device_type)) \
+         (dev)->error_code |= NBM_ERROR_INVALID_DEVICE
+
+#if NBM_CFG_ERROR_CALLBACK
+#define ERROR_CHECK(dev) \
+    if ((dev)->error_code && (dev)->on_error_callback) \
+        (dev)->on_error_callback((dev)->error_code)
+#else
+#define ERROR_CHECK(dev) ((void) 0)
+#endif
+
+#define SET_ERROR_AND_RUN_CALLBACK(dev, erno) \
+    do { \
+        (dev)->error_code |= (erno); \
+        ERROR_CHECK(dev); \
+    } while(0)
+
+#endif /* include guard */
@@ -0,0 +1,154 @@
+/*
+ * load pulse coordinator for the nbmx100x devices.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stddef.h>
+#include "nbm_pulse.h"
+#include "nbm_private.h"
+
+#if !NBM_CFG_CONVERSIONS || !NBM_CFG_STATUS
+#error "nbm_pulse.c needs NBM_CFG_CONVERSIONS and NBM_CFG_STATUS"
+#endif
+
+static bool nbm_pulse_read_field(struct nbm_device *dev, enum nbm_fields field, uint8_t *value);
+static bool nbm_pulse_is_charged(struct nbm_pulse *pulse);
+static void nbm_pulse_release(struct nbm_pulse *pulse);
+static bool nbm_pulse_time_reached(uint32_t now_ms, uint32_t t_ms);
+
+void nbm_pulse_init(struct nbm_pulse *pulse, struct nbm_device *dev, uint16_t cap_uf,
+        void (*on_ready)(bool charged)) {
+    pulse->dev = dev;
+    pulse->state = NBM_PULSE_IDLE;
+    pulse->deadline_ms = 0;
+    pulse->end_ms = 0;
+    pulse->need_mv = 0;
+    pulse->cap_uf = cap_uf;
+    pulse->forced = 0;
+    pulse->set_act = 0;
+    pulse->on_ready = on_ready;
+}
+
+void nbm_pulse_request(struct nbm_pulse *pulse, uint16_t expected_current_ma, uint16_t duration_ms,
+        uint32_t deadline_ms) {
+
+    struct nbm_device *dev = pulse->dev;
+    uint8_t vmin = 0;
+    uint8_t act = NBM_ACT_VAL_FORCE_ACTIVE_INACTIVE;
+    uint32_t drop_mv;
+
+    /* a new request replaces any still running */
+    if (pulse->state != NBM_PULSE_IDLE)
+        nbm_pulse_release(pulse);
+
+    pulse->deadline_ms = deadline_ms;
+    pulse->end_ms = deadline_ms + duration_ms;
+    pulse->need_mv = 0;
+
+    /* mA * ms is uC, over uF gives the drop in V so scale to mV. if vmin
+     * can't be read fall back to waiting for RDY */
+    if (pulse->cap_uf && !nbm_pulse_read_field(dev, NBM_VMIN, &vmin)) {
+        drop_mv = (uint32_t) expected_current_ma * duration_ms * 1000UL / pulse->cap_uf;
+        drop_mv += nbm_vmin_to_mv(vmin);
+        pulse->need_mv = drop_mv > UINT16_MAX ? UINT16_MAX : (uint16_t) drop_mv;
+    }
+
+    if (nbm_pulse_is_charged(pulse)) {
+        /* already enough in the cap, nothing to force */
+        pulse->state = NBM_PULSE_ACTIVE;
+        if (pulse->on_ready)
+            pulse->on_ready(1);
+        return;
+    }
+
+    /* leave ACT alone if the app already has it set, so release doesn't
+     * clear it from under them. if it can't be read assume it was clear */
+    nbm_pulse_read_field(dev, NBM_ACT, &act);
+    pulse->set_act = act != NBM_ACT_VAL_FORCE_ACTIVE_ENABLE;
+    if (pulse->set_act)
+        nbm_write(dev, NBM_ACT, NBM_ACT_VAL_FORCE_ACTIVE_ENABLE);
+#if NBM_CFG_PIN_HOOKS
+    if (dev->write_start_pin_fcn)
+        dev->error_code |= dev->write_start_pin_fcn(0, 1);
+#endif
+    pulse->forced = 1;
+    pulse->state = NBM_PULSE_ARMING;
+    ERROR_CHECK(dev);
+}
+
+void nbm_pulse_poll(struct nbm_pulse *pulse, uint32_t now_ms) {
+
+    bool charged;
+
+    switch (pulse->state) {
+        case NBM_PULSE_IDLE:
+            break;
+        case NBM_PULSE_ARMING:
+            charged = nbm_pulse_is_charged(pulse);
+            if (charged || nbm_pulse_time_reached(now_ms, pulse->deadline_ms)) {
+                pulse->state = NBM_PULSE_ACTIVE;
+                if (pulse->on_ready)
+                    pulse->on_ready(charged);
+            }
+            break;
+        case NBM_PULSE_ACTIVE:
+            if (nbm_pulse_time_reached(now_ms, pulse->end_ms))
+                nbm_pulse_release(pulse);
+            break;
+    }
+}
+
+void nbm_pulse_end(struct nbm_pulse *pulse) {
+    if (pulse->state != NBM_PULSE_IDLE)
+        nbm_pulse_release(pulse);
+}
+
+/* error_code is sticky so nbm_read() can't tell us if this read failed,
+ * returns 1 if it did */
+static bool nbm_pulse_read_field(struct nbm_device *dev, enum nbm_fields field, uint8_t *value) {
+
+    uint8_t reg = 0;
+    bool failed;
+
+    failed = dev->read_bytes_fcn(GET_ADDR(dev), GET_REG_FROM_FIELD(field), &reg, 1);
+    dev->error_code |= failed;
+    *value = reg >> GET_LSB_POS_FROM_FIELD(field) & GET_VALUE_MASK_FROM_FIELD(field);
+    return failed;
+}
+
+/* a failed read counts as not charged, so the booster is forced on anyway */
+static bool nbm_pulse_is_charged(struct nbm_pulse *pulse) {
+
+    struct nbm_status status;
+
+    if (nbm_read_status(pulse->dev, &status))
+        return 0;
+    return pulse->need_mv ? nbm_vcap_to_mv(status.vcap) >= pulse->need_mv : status.rdy;
+}
+
+static void nbm_pulse_release(struct nbm_pulse *pulse) {
+
+    struct nbm_device *dev = pulse->dev;
+
+    /* only undo what we did, if the cap was already charged the booster was
+     * never forced on */
+    if (pulse->forced) {
+        if (pulse->set_act)
+            nbm_write(dev, NBM_ACT, NBM_ACT_VAL_FORCE_ACTIVE_INACTIVE);
+#if NBM_CFG_PIN_HOOKS
+        if (dev->write_start_pin_fcn)
+            dev->error_code |= dev->write_start_pin_fcn(0, 0);
+#endif
+        pulse->forced = 0;
+        pulse->set_act = 0;
+    }
+    pulse->state = NBM_PULSE_IDLE;
+    ERROR_CHECK(dev);
+}
+
+/* wrap around safe now >= t */
+static bool nbm_pulse_time_reached(uint32_t now_ms, uint32_t t_ms) {
+    return (uint32_t) (now_ms - t_ms) < 0x80000000UL;
+}
@@ -0,0 +1,61 @@
+/*
+ * load pulse coordinator for the nbmx100x devices. for a load (eg a radio
+ * tx) known to be coming, nbm_pulse_request() forces the booster on via ACT
+ * (and START if the pin hook is set) if vcap is not already enough for the
+ * pulse, and tells you when it is.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_PULSE_H_
+#define NBM_PULSE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+
+enum nbm_pulse_states {
+    NBM_PULSE_IDLE = 0,
+    NBM_PULSE_ARMING = 1, /* waiting for vcap to get high enough */
+    NBM_PULSE_ACTIVE = 2  /* app told it can draw, waiting for the pulse to end */
+};
+
+/* one per device, times are in ms on any free running clock of the users */
+struct nbm_pulse {
+    struct nbm_device *dev;
+    enum nbm_pulse_states state;
+    uint32_t deadline_ms;
+    uint32_t end_ms;
+    uint16_t need_mv;   /* vcap needed to carry the pulse without going under vmin */
+    uint16_t cap_uf;    /* 0 if unknown, then RDY is waited for instead */
+    bool forced;        /* we set START (and maybe ACT) so have to put them back */
+    bool set_act;       /* ACT was clear before we set it */
+    /* called once the pulse can go ahead, charged is 0 if the deadline came
+     * before vcap was high enough */
+    void (*on_ready)(bool charged);
+};
+
+/* dev must already be set up with nbm_init() */
+void nbm_pulse_init(struct nbm_pulse *pulse, struct nbm_device *dev, uint16_t cap_uf,
+    void (*on_ready)(bool charged));
+
+/* on_ready is called straight away if vcap is already enough for
+ * expected_current_ma over duration_ms, otherwise from nbm_pulse_poll() once
+ * it is, or at deadline_ms regardless. the device goes back to how it was
+ * duration_ms after that, or on nbm_pulse_end(). a new request replaces any
+ * still running */
+void nbm_pulse_request(struct nbm_pulse *pulse, uint16_t expected_current_ma, uint16_t duration_ms,
+    uint32_t deadline_ms);
+void nbm_pulse_poll(struct nbm_pulse *pulse, uint32_t now_ms);
+void nbm_pulse_end(struct nbm_pulse *pulse);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* include guard */
@@ -0,0 +1,132 @@
+/*
+ * fixed size supply health statistics for the nbmx100x devices.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "nbm_stats.h"
+
+#if !NBM_CFG_CONVERSIONS || !NBM_CFG_STATUS
+#error "nbm_stats.c needs NBM_CFG_CONVERSIONS and NBM_CFG_STATUS"
+#endif
+
+static void flag_update(struct nbm_flag_stats *flag, bool was_set, bool is_set, uint32_t dt);
+static void flag_merge(struct nbm_flag_stats *dst, const struct nbm_flag_stats *src);
+
+void nbm_stats_init(struct nbm_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->pulse_vcap_min_mv = UINT16_MAX;
+}
+
+void nbm_stats_update(struct nbm_stats *stats, const struct nbm_status *status, uint32_t now_ms) {
+
+    uint32_t dt;
+    uint16_t mv;
+
+    stats->n_samples++;
+    stats->vcap_hist[status->vcap & (NBM_STATS_N_VCAP_CODES - 1)]++;
+
+    if (!stats->has_sample) {
+        /* nothing to compare against, just count any flags already up */
+        flag_update(&stats->ew, 0, status->ew, 0);
+        flag_update(&stats->alrm, 0, status->alrm, 0);
+        flag_update(&stats->lowbat, 0, status->lowbat, 0);
+        stats->peak_vcap = status->vcap;
+        stats->has_sample = 1;
+    } else {
+        dt = now_ms - stats->last_ms;
+
+        flag_update(&stats->ew, stats->last.ew, status->ew, dt);
+        flag_update(&stats->alrm, stats->last.alrm, status->alrm, dt);
+        flag_update(&stats->lowbat, stats->last.lowbat, status->lowbat, dt);
+
+        if (status->rdy && !stats->last.rdy)
+            stats->n_charge_cycles++;
+
+        /* vcap falling NBM_STATS_PULSE_DROP_CODES below the highest level
+         * since the last pulse marks a pulse, that level is what it started
+         * from. a single code step is just ripple. the pulse lasts until vcap
+         * is back within the same number of codes of where it started (having
+         * climbed at least that far off the bottom) or RDY rises, so ripple
+         * while it recharges is not taken as more pulses */
+        if (!stats->in_pulse) {
+            if (status->vcap > stats->peak_vcap) {
+                stats->peak_vcap = status->vcap;
+            } else if (stats->peak_vcap - status->vcap >= NBM_STATS_PULSE_DROP_CODES) {
+                mv = nbm_vcap_to_mv(stats->peak_vcap);
+                stats->n_pulses++;
+                stats->pulse_vcap_sum_mv += mv;
+                if (mv < stats->pulse_vcap_min_mv)
+                    stats->pulse_vcap_min_mv = mv;
+                if (mv > stats->pulse_vcap_max_mv)
+                    stats->pulse_vcap_max_mv = mv;
+                stats->trough_vcap = status->vcap;
+                stats->in_pulse = 1;
+            }
+        } else if (status->vcap < stats->trough_vcap) {
+            stats->trough_vcap = status->vcap;
+        } else if ((stats->peak_vcap - status->vcap < NBM_STATS_PULSE_DROP_CODES &&
+                status->vcap - stats->trough_vcap >= NBM_STATS_PULSE_DROP_CODES) ||
+                (status->rdy && !stats->last.rdy)) {
+            stats->in_pulse = 0;
+            stats->peak_vcap = status->vcap;
+        }
+    }
+
+    stats->last = *status;
+    stats->last_ms = now_ms;
+}
+
+void nbm_stats_merge(struct nbm_stats *dst, const struct nbm_stats *src) {
+
+    uint8_t i;
+
+    dst->n_samples += src->n_samples;
+    for (i = 0; i < NBM_STATS_N_VCAP_CODES; i++)
+        dst->vcap_hist[i] += src->vcap_hist[i];
+
+    dst->n_pulses += src->n_pulses;
+    dst->pulse_vcap_sum_mv += src->pulse_vcap_sum_mv;
+    if (src->pulse_vcap_min_mv < dst->pulse_vcap_min_mv)
+        dst->pulse_vcap_min_mv = src->pulse_vcap_min_mv;
+    if (src->pulse_vcap_max_mv > dst->pulse_vcap_max_mv)
+        dst->pulse_vcap_max_mv = src->pulse_vcap_max_mv;
+
+    dst->n_charge_cycles += src->n_charge_cycles;
+
+    flag_merge(&dst->ew, &src->ew);
+    flag_merge(&dst->alrm, &src->alrm);
+    flag_merge(&dst->lowbat, &src->lowbat);
+}
+
+uint16_t nbm_stats_pulse_vcap_mean_mv(const struct nbm_stats *stats) {
+    if (!stats->n_pulses)
+        return 0;
+    return (uint16_t) (stats->pulse_vcap_sum_mv / stats->n_pulses);
+}
+
+static void flag_update(struct nbm_flag_stats *flag, bool was_set, bool is_set, uint32_t dt) {
+
+    /* the time between two samples is put down to the flag if it was set at
+     * the first of them */
+    if (was_set) {
+        flag->total_ms += dt;
+        flag->current_ms += dt;
+        if (flag->current_ms > flag->max_ms)
+            flag->max_ms = flag->current_ms;
+    }
+
+    if (is_set && !was_set)
+        flag->count++;
+    else if (!is_set)
+        flag->current_ms = 0;
+}
+
+static void flag_merge(struct nbm_flag_stats *dst, const struct nbm_flag_stats *src) {
+    dst->count += src->count;
+    dst->total_ms += src->total_ms;
+    if (src->max_ms > dst->max_ms)
+        dst->max_ms = src->max_ms;
+}
@@ -0,0 +1,83 @@
+/*
+ * fixed size supply health statistics for the nbmx100x devices. feed it each
+ * nbm_status you read and it keeps vcap at the start of load pulses, a
+ * histogram of vcap codes, EW/ALRM/LOWBAT episodes and charge cycles. stats
+ * from several devices or time windows can be merged for fleet roll ups.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_STATS_H_
+#define NBM_STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+
+/* one bucket per NBM_VCAP_VAL_* code */
+#define NBM_STATS_N_VCAP_CODES 32
+
+/* how many codes vcap has to fall before it counts as a load pulse rather
+ * than ripple, override from the command line */
+#ifndef NBM_STATS_PULSE_DROP_CODES
+#define NBM_STATS_PULSE_DROP_CODES 2
+#endif
+
+/* how often a status flag was raised and for how long, in ms. durations are
+ * only as good as the rate you sample at */
+struct nbm_flag_stats {
+    uint32_t count;
+    uint32_t total_ms;
+    uint32_t max_ms;
+    uint32_t current_ms; /* length of the episode in progress, 0 if none */
+};
+
+struct nbm_stats {
+    uint32_t n_samples;
+    uint32_t vcap_hist[NBM_STATS_N_VCAP_CODES];
+
+    /* vcap (in mV) seen just before each load pulse pulled it down, min is
+     * UINT16_MAX until the first pulse */
+    uint32_t n_pulses;
+    uint64_t pulse_vcap_sum_mv;
+    uint16_t pulse_vcap_min_mv;
+    uint16_t pulse_vcap_max_mv;
+
+    /* times RDY went high, ie the capacitor finished charging */
+    uint32_t n_charge_cycles;
+
+    struct nbm_flag_stats ew;
+    struct nbm_flag_stats alrm;
+    struct nbm_flag_stats lowbat;
+
+    /* tracking state, not touched by merge */
+    struct nbm_status last;
+    uint32_t last_ms;
+    uint8_t peak_vcap;     /* highest vcap code since the last pulse */
+    uint8_t trough_vcap;   /* lowest vcap code in the current pulse */
+    bool in_pulse;
+    bool has_sample;
+};
+
+void nbm_stats_init(struct nbm_stats *stats);
+
+/* O(1), now_ms is any free running ms counter */
+void nbm_stats_update(struct nbm_stats *stats, const struct nbm_status *status, uint32_t now_ms);
+
+/* add the totals of src into dst, episodes still running in src are counted
+ * as they stand */
+void nbm_stats_merge(struct nbm_stats *dst, const struct nbm_stats *src);
+
+/* mean vcap at the start of a pulse in mV, 0 if no pulses seen */
+uint16_t nbm_stats_pulse_vcap_mean_mv(const struct nbm_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* include guard */
@@ -0,0 +1,69 @@
+/*
+ * check of the load pulse detection in the health statistics: vcap code
+ * sequences with ripple on the way down and while recharging are fed in and
+ * the number of pulses and the vcap they started from have to come out right.
+ * by thomas169
+ *
+ * build and run:
+ *     cc -o nbm_stats_check nbm_stats_check.c nbm_stats.c nbm.c && ./nbm_stats_check
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+#include "nbm_stats.h"
+
+#define MAX_SAMPLES 32
+
+struct scenario {
+    const char *name;
+    uint8_t vcap[MAX_SAMPLES];  /* 0 ends the sequence */
+    uint32_t n_pulses;
+    uint8_t start_vcap;         /* code every pulse should start from */
+};
+
+static const struct scenario scenarios[] = {
+    {"ripple only", {28, 27, 28, 27, 28, 27, 27, 28}, 0, 0},
+    {"one pulse", {28, 28, 20, 22, 24, 26, 28, 28}, 1, 28},
+    {"ripple on the way down", {28, 27, 26, 24, 22, 20, 24, 28}, 1, 28},
+    {"ripple while recharging", {28, 20, 21, 22, 21, 20, 22, 23, 22, 21, 24, 25, 24, 26, 25, 27, 28, 27, 28}, 1, 28},
+    {"two pulses", {28, 20, 22, 24, 26, 28, 27, 28, 21, 23, 25, 27, 28}, 2, 28}
+};
+
+static bool run(const struct scenario *sc) {
+
+    struct nbm_stats stats;
+    struct nbm_status status = {0};
+    uint16_t start_mv = sc->start_vcap ? nbm_vcap_to_mv(sc->start_vcap) : 0;
+    uint8_t i;
+    bool ok;
+
+    nbm_stats_init(&stats);
+    for (i = 0; i < MAX_SAMPLES && sc->vcap[i]; i++) {
+        status.vcap = sc->vcap[i];
+        nbm_stats_update(&stats, &status, i * 10UL);
+    }
+
+    ok = stats.n_pulses == sc->n_pulses;
+    if (sc->n_pulses)
+        ok &= stats.pulse_vcap_min_mv == start_mv && stats.pulse_vcap_max_mv == start_mv;
+
+    printf("%s %s: %lu pulses (want %lu), start %u..%u mV (want %u)\n", ok ? "ok  " : "FAIL", sc->name,
+        (unsigned long) stats.n_pulses, (unsigned long) sc->n_pulses,
+        stats.n_pulses ? stats.pulse_vcap_min_mv : 0, stats.pulse_vcap_max_mv, start_mv);
+    return ok;
+}
+
+int main(void) {
+
+    size_t i;
+    bool ok = 1;
+
+    for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        ok &= run(&scenarios[i]);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/*
+ * change driven events for the nbmx100x status and measurement fields.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "nbm_subscribe.h"
+#include "nbm_private.h"
+
+#define DECODE_FIELD(regs, field) \
+    ((uint8_t) ((regs)[GET_REG_FROM_FIELD(field)] >> GET_LSB_POS_FROM_FIELD(field) & \
+        GET_VALUE_MASK_FROM_FIELD(field)))
+
+static bool nbm_sub_is_supported(enum nbm_fields field);
+
+void nbm_sub_init(struct nbm_subscriber *sub, struct nbm_device *dev) {
+    memset(sub, 0, sizeof(*sub));
+    sub->dev = dev;
+}
+
+bool nbm_subscribe(struct nbm_subscriber *sub, enum nbm_fields field, uint8_t hysteresis,
+        void (*callback)(enum nbm_fields field, uint8_t old_value, uint8_t new_value)) {
+
+    struct nbm_subscription *s;
+
+    if (!nbm_sub_is_supported(field) || !callback || sub->n_subs >= NBM_SUB_MAX_SUBSCRIPTIONS)
+        return 1;
+
+    s = &sub->subs[sub->n_subs++];
+    s->field = field;
+    s->hysteresis = (field == NBM_VCAP || field == NBM_VCHEND) ? hysteresis : 0;
+    s->callback = callback;
+    /* if already running, start from what was last read */
+    s->reported = sub->primed ? DECODE_FIELD(sub->last, field) : 0;
+
+    sub->watch[GET_REG_FROM_FIELD(field)] |= GET_MASK_FROM_FIELD(field);
+    return 0;
+}
+
+void nbm_sub_poll(struct nbm_subscriber *sub) {
+
+    uint8_t regs[NBM_SUB_N_REGS] = {0};
+    bool failed;
+
+    /* error_code is sticky so look at this read's own result, nothing is
+     * dispatched from a failed one */
+    failed = sub->dev->read_bytes_fcn(GET_ADDR(sub->dev), NBM_REG_STATUS, regs, NBM_SUB_N_REGS);
+    sub->dev->error_code |= failed;
+    if (failed) {
+        ERROR_CHECK(sub->dev);
+        return;
+    }
+
+    nbm_sub_process(sub, regs);
+}
+
+void nbm_sub_process(struct nbm_subscriber *sub, const uint8_t *regs) {
+
+    struct nbm_subscription *s;
+    uint8_t changed[NBM_SUB_N_REGS];
+    uint8_t any;
+    uint8_t value;
+    uint8_t old_value;
+    uint8_t i;
+
+    if (!sub->primed) {
+        memcpy(sub->last, regs, NBM_SUB_N_REGS);
+        for (i = 0; i < sub->n_subs; i++)
+            sub->subs[i].reported = DECODE_FIELD(regs, sub->subs[i].field);
+        sub->primed = 1;
+        return;
+    }
+
+    /* one xor/mask pass over the registers, most polls stop here */
+    any = 0;
+    for (i = 0; i < NBM_SUB_N_REGS; i++) {
+        changed[i] = (regs[i] ^ sub->last[i]) & sub->watch[i];
+        any |= changed[i];
+    }
+    memcpy(sub->last, regs, NBM_SUB_N_REGS);
+    if (!any)
+        return;
+
+    for (i = 0; i < sub->n_subs; i++) {
+        s = &sub->subs[i];
+        if (!(changed[GET_REG_FROM_FIELD(s->field)] & GET_MASK_FROM_FIELD(s->field)))
+            continue;
+
+        /* hysteresis is against what was last reported, so a slow drift is
+         * still reported once it has gone far enough */
+        value = DECODE_FIELD(regs, s->field);
+        if ((value > s->reported ? value - s->reported : s->reported - value) <= s->hysteresis)
+            continue;
+
+        old_value = s->reported;
+        s->reported = value;
+        s->callback(s->field, old_value, value);
+    }
+}
+
+/* NOTE: as in nbm.c do not use default when switching on the enum */
+static bool nbm_sub_is_supported(enum nbm_fields field) {
+    switch (field) {
+        case NBM_LOWBAT:
+        case NBM_EW:
+        case NBM_ALRM:
+        case NBM_RDY:
+        case NBM_VCAP:
+        case NBM_VCHEND:
+            return 1;
+        case NBM_CHENGY:
+        case NBM_PROF:
+        case NBM_RSTPF:
+        case NBM_ACT:
+        case NBM_ECM:
+        case NBM_EOD:
+        case NBM_VFIX:
+        case NBM_VSET:
+        case NBM_ICH:
+        case NBM_VDHHIZ:
+        case NBM_VMIN:
+        case NBM_AUTOMODE:
+        case NBM_EEW:
+        case NBM_VEW:
+        case NBM_BALMODE:
+        case NBM_ENBAL:
+        case NBM_VCAPMAX:
+        case NBM_OPT_MARG:
+            return 0;
+    }
+    return 0;
+}
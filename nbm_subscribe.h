@@ -0,0 +1,64 @@
+/*
+ * change driven events for the nbmx100x status and measurement fields.
+ * register a callback per field (with optional hysteresis for VCAP/VCHEND)
+ * then each nbm_sub_poll() does one bus read and calls back only for the
+ * fields that actually changed.
+ * by thomas169
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NBM_SUBSCRIBE_H_
+#define NBM_SUBSCRIBE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nbm.h"
+
+/* override from the command line if you need more */
+#ifndef NBM_SUB_MAX_SUBSCRIPTIONS
+#define NBM_SUB_MAX_SUBSCRIPTIONS 8
+#endif
+
+/* registers status through vchend are watched, read in one go */
+#define NBM_SUB_N_REGS (NBM_REG_VCHEND - NBM_REG_STATUS + 1)
+
+struct nbm_subscription {
+    enum nbm_fields field;
+    uint8_t hysteresis;    /* in codes, only used for NBM_VCAP and NBM_VCHEND */
+    uint8_t reported;      /* value last passed to the callback */
+    void (*callback)(enum nbm_fields field, uint8_t old_value, uint8_t new_value);
+};
+
+struct nbm_subscriber {
+    struct nbm_device *dev;
+    struct nbm_subscription subs[NBM_SUB_MAX_SUBSCRIPTIONS];
+    uint8_t n_subs;
+    uint8_t watch[NBM_SUB_N_REGS];  /* or of the masks of all subscribed fields */
+    uint8_t last[NBM_SUB_N_REGS];
+    bool primed;
+};
+
+void nbm_sub_init(struct nbm_subscriber *sub, struct nbm_device *dev);
+
+/* fields in status, vcap and vchend can be subscribed to (not chengy). returns
+ * 1 on failure, ie field not supported or no room left */
+bool nbm_subscribe(struct nbm_subscriber *sub, enum nbm_fields field, uint8_t hysteresis,
+    void (*callback)(enum nbm_fields field, uint8_t old_value, uint8_t new_value));
+
+/* read the watched registers and dispatch. the first call only takes a
+ * baseline and calls nothing. nothing is dispatched if the read fails */
+void nbm_sub_poll(struct nbm_subscriber *sub);
+
+/* as nbm_sub_poll() for when you already have registers status..vchend */
+void nbm_sub_process(struct nbm_subscriber *sub, const uint8_t *regs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* include guard */
@@ -0,0 +1,546 @@
+/*
+ * host side design space sweep for the nbmx100x devices. every combination of
+ * PROF, OPT_MARG, ICH and VFIX is written through the library to a simulated
+ * device and run against recorded load profiles, the combinations being shared
+ * out over all cores. settings are ranked by battery energy (of those that
+ * never let vcap drop below VMIN) and the energy vs voltage margin pareto
+ * frontier is written out as csv.
+ * by thomas169
+ *
+ * build (posix host):
+ *     cc -O2 -o nbm_sweep nbm_sweep.c nbm.c -lpthread -lm
+ *
+ * load profiles are text files, one pulse per line as
+ *     current_ma,duration_ms,gap_ms
+ * where gap_ms is the idle time after the pulse. blank lines and lines
+ * starting with # are skipped.
+ *
+ * the simulated device is a deliberately simple model and not the real silicon:
+ *  - the booster draws ICH from the battery at VBAT and puts it into the cap
+ *    (at the given efficiency) until vcap reaches VCHEND, so vcap^2 rises
+ *    linearly with time. battery energy is VBAT*ICH*t plus the ICH^2*R loss
+ *    in the battery internal resistance.
+ *  - the cap leaks through a parallel resistance, so the higher it is held
+ *    the more it loses. that is what makes VFIX/VCHEND (and so PROF and
+ *    OPT_MARG) cost energy rather than just margin. vcap settles towards
+ *    sqrt(P*R) while charging at power P and decays when the booster is off,
+ *    once at VCHEND the booster tops up what leaks until the next pulse.
+ *  - a pulse takes current*VSET*duration (over the output efficiency) out of
+ *    the cap, the booster does not help during the pulse and the leak during
+ *    it is ignored.
+ *  - with OPT_MARG inactive VCHEND is VFIX. otherwise the optimiser sets VCHEND
+ *    to the lowest vcap code that would have kept each of the last PROF pulses
+ *    above the OPT_MARG level, starting from VFIX until it has seen a pulse.
+ *    as PROF does nothing without the optimiser only PROF 1 is run then.
+ *  - the cap starts empty and is charged to VFIX before the first pulse. what
+ *    is left in it at the end of each profile is credited back at what it
+ *    cost to charge, so a setting is not made to look cheap by ending the
+ *    profile with the cap still low.
+ *  - VCHEND is read only on the device so it is an output of the sweep rather
+ *    than an input, VFIX is the charge setting swept in its place.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "nbm.h"
+
+#if !NBM_CFG_CONVERSIONS || !NBM_CFG_PROF
+#error "nbm_sweep.c needs NBM_CFG_CONVERSIONS and NBM_CFG_PROF"
+#endif
+
+#define N_REGISTERS 14
+#define N_PROF 63
+#define N_OPT_MARG 4
+#define N_ICH (NBM_ICH_VAL_50mA - NBM_ICH_VAL_2mA + 1)
+#define N_VFIX (NBM_VFIX_VAL_5V54 - NBM_VFIX_VAL_2V60 + 1)
+#define N_COMBOS (N_PROF * N_OPT_MARG * N_ICH * N_VFIX)
+/* the i2c address picks the simulated device, so one per worker */
+#define MAX_WORKERS 255
+/* combinations a worker takes at a time */
+#define CHUNK 64
+
+struct pulse {
+    double current_ma;
+    double duration_ms;
+    double gap_ms;
+};
+
+struct profile {
+    const char *name;
+    struct pulse *pulses;
+    size_t n_pulses;
+};
+
+/* the setup being swept over, in si units */
+struct sim_params {
+    double cap_f;
+    double vbat_v;
+    double rbat_ohm;
+    double vset_v;
+    double vmin_v;
+    double eff_boost;
+    double eff_out;
+    double rleak_ohm;   /* cap leakage as a parallel resistance, 0 for none */
+};
+
+struct fake_nbm {
+    uint8_t registers[N_REGISTERS];
+    /* vcap each of the last N_PROF pulses needed to start from, a ring buffer */
+    double need_v[N_PROF];
+};
+
+struct result {
+    uint8_t prof;
+    uint8_t opt_marg;
+    uint8_t ich;
+    uint8_t vfix;
+    bool valid;         /* combination was run */
+    bool feasible;      /* vcap never dropped below vmin */
+    double energy_mj;   /* from the battery over all profiles, less what is left in the cap */
+    double margin_mv;   /* smallest vcap - vmin seen at the end of a pulse */
+    double vchend_v;    /* mean vchend the device charged to */
+};
+
+struct sweep {
+    const struct sim_params *params;
+    const struct profile *profiles;
+    size_t n_profiles;
+    struct result *results;
+    volatile uint32_t next;
+};
+
+struct worker {
+    struct sweep *sweep;
+    uint8_t id;
+};
+
+static struct fake_nbm fake_nbms[MAX_WORKERS];
+/* nbm_vcap_to_mv() for every code, in volts, filled once in main() as the
+ * simulation looks it up twice a pulse */
+static double vcap_v[NBM_VCAP_VAL_5V54 + 1];
+
+static bool fake_read(uint8_t addr, uint8_t reg, uint8_t *value, uint8_t len) {
+    if (addr >= MAX_WORKERS || reg + len > N_REGISTERS)
+        return 1;
+    memcpy(value, &fake_nbms[addr].registers[reg], len);
+    return 0;
+}
+
+static bool fake_write(uint8_t addr, uint8_t reg, const uint8_t *value, uint8_t len) {
+    if (addr >= MAX_WORKERS || reg + len > N_REGISTERS)
+        return 1;
+    memcpy(&fake_nbms[addr].registers[reg], value, len);
+    return 0;
+}
+
+static void fake_reset(struct fake_nbm *fake) {
+    static const uint8_t defaults[N_REGISTERS] =
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x09, 0x80, 0x80, 0x00, 0x00};
+    memcpy(fake->registers, defaults, sizeof(defaults));
+    memset(fake->need_v, 0, sizeof(fake->need_v));
+}
+
+/* smallest vcap code at or above v, top code if none is */
+static uint8_t volts_to_vcap_code(double v) {
+    uint8_t lo = NBM_VCAP_VAL_1V10;
+    uint8_t hi = NBM_VCAP_VAL_5V54;
+    uint8_t mid;
+
+    while (lo < hi) {
+        mid = (uint8_t) ((lo + hi) / 2);
+        if (vcap_v[mid] >= v)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+static double opt_marg_to_v(uint8_t opt_marg) {
+    switch (opt_marg) {
+        case NBM_OPT_MARG_VAL_2V19:
+            return 2.19;
+        case NBM_OPT_MARG_VAL_2V60:
+            return 2.60;
+        case NBM_OPT_MARG_VAL_2V95:
+            return 2.95;
+    }
+    return 0.0;
+}
+
+/* time to charge (or with p_charge 0, leak) the cap from v0 to v1 at
+ * p_charge into it, HUGE_VAL if leakage means it never gets there */
+static double charge_time(const struct sim_params *p, double p_charge, double v0, double v1) {
+
+    double vinf2;
+
+    if (p->rleak_ohm <= 0.0)
+        return p->cap_f * (v1 * v1 - v0 * v0) / (2.0 * p_charge);
+
+    vinf2 = p_charge * p->rleak_ohm;
+    if ((v1 * v1 - vinf2) / (v0 * v0 - vinf2) <= 0.0)
+        return HUGE_VAL;
+    return p->rleak_ohm * p->cap_f / 2.0 * log((v0 * v0 - vinf2) / (v1 * v1 - vinf2));
+}
+
+/* vcap after t at p_charge into the cap (or 0 to just leak) from v0 */
+static double charge_for(const struct sim_params *p, double p_charge, double v0, double t) {
+
+    double vinf2;
+
+    if (p->rleak_ohm <= 0.0)
+        return sqrt(v0 * v0 + 2.0 * p_charge * t / p->cap_f);
+
+    vinf2 = p_charge * p->rleak_ohm;
+    return sqrt(vinf2 + (v0 * v0 - vinf2) * exp(-2.0 * t / (p->rleak_ohm * p->cap_f)));
+}
+
+/* run one profile on the fake device as configured through its registers,
+ * accumulating into res */
+static void simulate(struct fake_nbm *fake, const struct sim_params *p,
+        const struct profile *profile, struct result *res, double *vchend_sum, size_t *n_charges) {
+
+    const uint8_t *r = fake->registers;
+    uint8_t prof = (uint8_t) ((r[NBM_REG_PROFILE_MSB] & 0x3) << 4 | r[NBM_REG_COMMAND] >> 4);
+    uint8_t opt_marg = r[NBM_REG_SET5] & 0x3;
+    double ich_a = nbm_ich_to_ma(r[NBM_REG_SET2] >> 5) / 1000.0;
+    double vfix_v = nbm_vfix_to_mv(r[NBM_REG_SET1] >> 4) / 1000.0;
+    double vcapmax_v = nbm_vcapmax_to_mv(r[NBM_REG_SET4] >> 4 & 0x1) / 1000.0;
+    double marg_v = opt_marg_to_v(opt_marg);
+    bool optimiser = prof && opt_marg != NBM_OPT_MARG_VAL_INACITVE;
+    /* power into the cap while charging, and from the battery */
+    double p_charge = ich_a * p->vbat_v * p->eff_boost;
+    double p_batt = ich_a * p->vbat_v + ich_a * ich_a * p->rbat_ohm;
+    double v = vfix_v;
+    double vchend = vfix_v;
+    double t;
+    size_t n_seen = 0;
+    size_t i;
+    size_t k;
+
+    /* the cap starts empty and is charged to vfix before the first pulse,
+     * if the leak is more than ICH can make up it never will be */
+    t = charge_time(p, p_charge, 0.0, vfix_v);
+    if (t == HUGE_VAL) {
+        res->margin_mv = -1e9;
+        return;
+    }
+    res->energy_mj += p_batt * t * 1000.0;
+
+    for (i = 0; i < profile->n_pulses; i++) {
+        const struct pulse *pulse = &profile->pulses[i];
+        double e_load = pulse->current_ma / 1000.0 * p->vset_v * pulse->duration_ms / 1000.0 / p->eff_out;
+        double v2 = v * v - 2.0 * e_load / p->cap_f;
+        double v_end = v2 > 0.0 ? sqrt(v2) : 0.0;
+        double t_full;
+
+        if ((v_end - p->vmin_v) * 1000.0 < res->margin_mv)
+            res->margin_mv = (v_end - p->vmin_v) * 1000.0;
+
+        /* what this pulse would have needed to stay above the margin */
+        fake->need_v[n_seen % N_PROF] = sqrt(marg_v * marg_v + 2.0 * e_load / p->cap_f);
+        n_seen++;
+
+        if (optimiser) {
+            vchend = 0.0;
+            for (k = 0; k < prof && k < n_seen; k++)
+                if (fake->need_v[(n_seen - 1 - k) % N_PROF] > vchend)
+                    vchend = fake->need_v[(n_seen - 1 - k) % N_PROF];
+            vchend = vcap_v[volts_to_vcap_code(vchend)];
+        }
+        if (vchend > vcapmax_v)
+            vchend = vcapmax_v;
+
+        fake->registers[NBM_REG_VCHEND] = volts_to_vcap_code(vchend);
+        *vchend_sum += vchend;
+        (*n_charges)++;
+
+        /* charge through the gap, or as far as vchend. if the optimiser
+         * dropped vchend below vcap let it leak down to it instead */
+        t = pulse->gap_ms / 1000.0;
+        if (v_end < vchend) {
+            t_full = charge_time(p, p_charge, v_end, vchend);
+            if (t_full < t) {
+                v = vchend;
+                res->energy_mj += p_batt * t_full * 1000.0;
+                t -= t_full;
+            } else {
+                v = charge_for(p, p_charge, v_end, t);
+                res->energy_mj += p_batt * t * 1000.0;
+                t = 0.0;
+            }
+        } else if (p->rleak_ohm > 0.0 && v_end > vchend) {
+            t_full = charge_time(p, 0.0, v_end, vchend);
+            if (t_full < t) {
+                v = vchend;
+                t -= t_full;
+            } else {
+                v = charge_for(p, 0.0, v_end, t);
+                t = 0.0;
+            }
+        } else {
+            v = v_end;
+        }
+
+        /* held at vchend for the rest of the gap, topping up the leak */
+        if (p->rleak_ohm > 0.0)
+            res->energy_mj += v * v / p->rleak_ohm * t * p_batt / p_charge * 1000.0;
+        fake->registers[NBM_REG_VCAP] = volts_to_vcap_code(v);
+    }
+
+    /* credit what is still in the cap, at what it costs to put there */
+    res->energy_mj -= p->cap_f * v * v / 2.0 * p_batt / p_charge * 1000.0;
+}
+
+static void combo_from_index(uint32_t index, struct result *res) {
+    res->vfix = (uint8_t) (NBM_VFIX_VAL_2V60 + index % N_VFIX);
+    index /= N_VFIX;
+    res->ich = (uint8_t) (NBM_ICH_VAL_2mA + index % N_ICH);
+    index /= N_ICH;
+    res->opt_marg = (uint8_t) (index % N_OPT_MARG);
+    index /= N_OPT_MARG;
+    res->prof = (uint8_t) NBM_PROF_VAL_PROFILE(index + 1);
+}
+
+static void *worker_main(void *arg) {
+
+    struct worker *w = (struct worker *) arg;
+    struct sweep *s = w->sweep;
+    struct nbm_device dev;
+    uint32_t start;
+    uint32_t index;
+    size_t i;
+
+    nbm_init(&dev, NBM5100A, w->id, fake_write, fake_read, NULL);
+
+    while ((start = __sync_fetch_and_add(&s->next, CHUNK)) < N_COMBOS) {
+        for (index = start; index < start + CHUNK && index < N_COMBOS; index++) {
+            struct result *res = &s->results[index];
+            double vchend_sum = 0.0;
+            size_t n_charges = 0;
+
+            combo_from_index(index, res);
+            if (res->opt_marg == NBM_OPT_MARG_VAL_INACITVE && res->prof != 1)
+                continue;
+
+            res->energy_mj = 0.0;
+            res->margin_mv = 1e9;
+
+            for (i = 0; i < s->n_profiles; i++) {
+                fake_reset(&fake_nbms[w->id]);
+                dev.error_code = NBM_ERROR_NO_ERROR;
+                nbm_write(&dev, NBM_PROF, res->prof);
+                nbm_write(&dev, NBM_OPT_MARG, res->opt_marg);
+                nbm_write(&dev, NBM_ICH, res->ich);
+                nbm_write(&dev, NBM_VFIX, res->vfix);
+                if (dev.error_code)
+                    break;
+                simulate(&fake_nbms[w->id], s->params, &s->profiles[i], res, &vchend_sum, &n_charges);
+            }
+
+            if (dev.error_code) {
+                fprintf(stderr, "nbm error %d writing combination %u\n", dev.error_code, index);
+                continue;
+            }
+
+            res->vchend_v = n_charges ? vchend_sum / n_charges : 0.0;
+            res->feasible = res->margin_mv >= 0.0;
+            res->valid = 1;
+        }
+    }
+    return NULL;
+}
+
+static int load_profile(const char *path, struct profile *profile) {
+
+    FILE *f;
+    char line[256];
+    struct pulse pulse;
+    size_t cap = 0;
+
+    f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    profile->name = path;
+    profile->pulses = NULL;
+    profile->n_pulses = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+            continue;
+        if (sscanf(line, "%lf,%lf,%lf", &pulse.current_ma, &pulse.duration_ms, &pulse.gap_ms) != 3) {
+            fprintf(stderr, "%s: bad line: %s", path, line);
+            fclose(f);
+            return 1;
+        }
+        if (profile->n_pulses == cap) {
+            cap = cap ? cap * 2 : 64;
+            profile->pulses = realloc(profile->pulses, cap * sizeof(*profile->pulses));
+            if (!profile->pulses) {
+                fclose(f);
+                return 1;
+            }
+        }
+        profile->pulses[profile->n_pulses++] = pulse;
+    }
+
+    fclose(f);
+    if (!profile->n_pulses) {
+        fprintf(stderr, "%s: no pulses\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+/* energy in whole uJ, settings whose energy only differs by rounding noise
+ * are a tie and go by margin */
+static long long energy_uj(const struct result *res) {
+    return llround(res->energy_mj * 1000.0);
+}
+
+/* feasible first, then least energy, then most margin */
+static int compare_rank(const void *a, const void *b) {
+    const struct result *ra = (const struct result *) a;
+    const struct result *rb = (const struct result *) b;
+
+    if (ra->valid != rb->valid)
+        return ra->valid ? -1 : 1;
+    if (ra->feasible != rb->feasible)
+        return ra->feasible ? -1 : 1;
+    if (energy_uj(ra) != energy_uj(rb))
+        return energy_uj(ra) < energy_uj(rb) ? -1 : 1;
+    if (ra->margin_mv != rb->margin_mv)
+        return ra->margin_mv > rb->margin_mv ? -1 : 1;
+    return 0;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "usage: %s [options] profile.csv [profile.csv ...]\n"
+        "  -c uF    storage capacitance (default 1000)\n"
+        "  -b mV    battery voltage (default 3000)\n"
+        "  -r mohm  battery internal resistance (default 10000)\n"
+        "  -s mV    output voltage VSET (default 3000)\n"
+        "  -m mV    VMIN that vcap must stay above (default 2400)\n"
+        "  -e %%     booster efficiency (default 90)\n"
+        "  -l kohm  cap leakage as a parallel resistance, 0 for none (default 1000)\n"
+        "  -j n     worker threads (default all cores)\n"
+        "  -n n     number of ranked results to print (default 10)\n"
+        "  -o file  pareto frontier csv (default pareto.csv)\n", argv0);
+}
+
+int main(int argc, char **argv) {
+
+    struct sim_params params = {1000e-6, 3.0, 10.0, 3.0, 2.4, 0.9, 0.9, 1e6};
+    struct sweep sweep;
+    struct profile *profiles;
+    struct worker workers[MAX_WORKERS];
+    pthread_t threads[MAX_WORKERS];
+    const char *pareto_path = "pareto.csv";
+    long n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    long n_print = 10;
+    double best_margin;
+    FILE *f;
+    int opt;
+    long i;
+
+    while ((opt = getopt(argc, argv, "c:b:r:s:m:e:l:j:n:o:h")) != -1) {
+        switch (opt) {
+            case 'c': params.cap_f = atof(optarg) * 1e-6; break;
+            case 'b': params.vbat_v = atof(optarg) / 1000.0; break;
+            case 'r': params.rbat_ohm = atof(optarg) / 1000.0; break;
+            case 's': params.vset_v = atof(optarg) / 1000.0; break;
+            case 'm': params.vmin_v = atof(optarg) / 1000.0; break;
+            case 'e': params.eff_boost = atof(optarg) / 100.0; break;
+            case 'l': params.rleak_ohm = atof(optarg) * 1000.0; break;
+            case 'j': n_workers = atol(optarg); break;
+            case 'n': n_print = atol(optarg); break;
+            case 'o': pareto_path = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc || params.cap_f <= 0.0 || params.eff_boost <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (n_workers < 1)
+        n_workers = 1;
+    if (n_workers > MAX_WORKERS)
+        n_workers = MAX_WORKERS;
+
+    sweep.n_profiles = (size_t) (argc - optind);
+    profiles = calloc(sweep.n_profiles, sizeof(*profiles));
+    sweep.results = calloc(N_COMBOS, sizeof(*sweep.results));
+    if (!profiles || !sweep.results)
+        return 1;
+    for (i = 0; i < (long) sweep.n_profiles; i++)
+        if (load_profile(argv[optind + i], &profiles[i]))
+            return 1;
+
+    for (i = 0; i <= NBM_VCAP_VAL_5V54; i++)
+        vcap_v[i] = nbm_vcap_to_mv((uint8_t) i) / 1000.0;
+
+    sweep.params = &params;
+    sweep.profiles = profiles;
+    sweep.next = 0;
+
+    for (i = 0; i < n_workers; i++) {
+        workers[i].sweep = &sweep;
+        workers[i].id = (uint8_t) i;
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i])) {
+            fprintf(stderr, "could not start worker %ld\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < n_workers; i++)
+        pthread_join(threads[i], NULL);
+
+    qsort(sweep.results, N_COMBOS, sizeof(*sweep.results), compare_rank);
+
+    printf("rank  prof  opt_marg  ich_ma  vfix_mv  vchend_mv  energy_mj  margin_mv\n");
+    for (i = 0; i < n_print && i < N_COMBOS && sweep.results[i].feasible; i++) {
+        const struct result *res = &sweep.results[i];
+        printf("%4ld  %4u  %8u  %6u  %7u  %9.0f  %9.3f  %9.0f\n", i + 1, res->prof, res->opt_marg,
+            nbm_ich_to_ma(res->ich), nbm_vfix_to_mv(res->vfix), res->vchend_v * 1000.0,
+            res->energy_mj, res->margin_mv);
+    }
+    if (!sweep.results[0].feasible)
+        printf("no combination kept vcap above vmin\n");
+
+    /* ranked by energy already (ties by margin), so each point with more
+     * margin than all the cheaper ones before it is on the frontier */
+    f = fopen(pareto_path, "w");
+    if (!f) {
+        perror(pareto_path);
+        return 1;
+    }
+    fprintf(f, "prof,opt_marg,ich_ma,vfix_mv,vchend_mv,energy_mj,margin_mv\n");
+    best_margin = -1.0;
+    for (i = 0; i < N_COMBOS && sweep.results[i].feasible; i++) {
+        const struct result *res = &sweep.results[i];
+        if (res->margin_mv <= best_margin)
+            continue;
+        best_margin = res->margin_mv;
+        fprintf(f, "%u,%u,%u,%u,%.0f,%.6f,%.1f\n", res->prof, res->opt_marg, nbm_ich_to_ma(res->ich),
+            nbm_vfix_to_mv(res->vfix), res->vchend_v * 1000.0, res->energy_mj, res->margin_mv);
+    }
+    fclose(f);
+
+    return 0;
+}
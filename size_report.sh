@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# flash/ram footprint of nbm.c for each nbm_config.h configuration.
+# by thomas169
+#
+# uses whatever toolchain you point it at, eg for a cortex-m0:
+#     CC=arm-none-eabi-gcc SIZE=arm-none-eabi-size CFLAGS="-Os -mcpu=cortex-m0 -mthumb" ./size_report.sh
+#
+# text/data/bss are for nbm.c, dev_ram is sizeof(struct nbm_device). to see
+# when a change grows the footprint save the output and diff against it:
+#     ./size_report.sh > sizes.txt
+#     ... change things ...
+#     ./size_report.sh | diff sizes.txt -
+#
+# SPDX-License-Identifier: Apache-2.0
+
+CC=${CC:-cc}
+SIZE=${SIZE:-size}
+CFLAGS=${CFLAGS:--Os}
+
+DIR=$(cd "$(dirname "$0")" && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+ALL_OFF="-DNBM_CFG_VALIDATION=0 -DNBM_CFG_CONVERSIONS=0 -DNBM_CFG_PROF=0 -DNBM_CFG_CHENGY=0 \
+-DNBM_CFG_ERROR_CALLBACK=0 -DNBM_CFG_PIN_HOOKS=0 -DNBM_CFG_STATUS=0"
+
+# name:flags, each is the default (everything on) with the given changes
+CONFIGS="full:
+no_validation:-DNBM_CFG_VALIDATION=0
+no_conversions:-DNBM_CFG_CONVERSIONS=0
+no_prof:-DNBM_CFG_PROF=0
+no_chengy:-DNBM_CFG_CHENGY=0
+no_error_callback:-DNBM_CFG_ERROR_CALLBACK=0
+no_pin_hooks:-DNBM_CFG_PIN_HOOKS=0
+no_status:-DNBM_CFG_STATUS=0
+minimal:$ALL_OFF"
+
+echo "$CC $CFLAGS"
+printf '%-18s %6s %6s %6s %8s\n' config text data bss dev_ram
+
+echo "$CONFIGS" | while IFS=: read -r name flags; do
+    # shellcheck disable=SC2086
+    $CC $CFLAGS $flags -I"$DIR" -c "$DIR/nbm.c" -o "$TMP/nbm.o" || exit 1
+    # a lone nbm_device in bss gives its size without having to run anything
+    # shellcheck disable=SC2086
+    echo '#include "nbm.h"
+struct nbm_device nbm_size_probe;' | $CC $CFLAGS $flags -fno-common -I"$DIR" -x c -c - -o "$TMP/probe.o" || exit 1
+
+    set -- $($SIZE "$TMP/nbm.o" | tail -n 1)
+    text=$1 data=$2 bss=$3
+    set -- $($SIZE "$TMP/probe.o" | tail -n 1)
+    printf '%-18s %6s %6s %6s %8s\n' "$name" "$text" "$data" "$bss" "$3"
+done